@@ -14,96 +14,100 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <stdlib.h>
-#include <linux/fs.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
-#include <sys/types.h>
-#include <sys/ioctl.h>
 #include <errno.h>
-#include <assert.h>
 #include <string.h>
-#include <i2c/smbus.h>
 #include "24cXX.h"
 
-static int i2c_write_1b(struct eeprom *e, __u8 buf)
+// pass the geometry of [e], which callers may have changed, on to the
+// library
+static int update_geometry(struct eeprom *e)
 {
+	struct i2c_eeprom_geometry geo;
 	int r;
-	// we must simulate a plain I2C byte write with SMBus functions
-	r = i2c_smbus_write_byte(e->fd, buf);
-	if(r < 0)
-		fprintf(stderr, "Error i2c_write_1b: %s\n", strerror(errno));
-	usleep(10);
-	return r;
+
+	if(e->type != EEPROM_TYPE_8BIT_ADDR &&
+	   e->type != EEPROM_TYPE_16BIT_ADDR) {
+		fprintf(stderr, "ERR: unknown eeprom type\n");
+		return -1;
+	}
+	geo.size = e->size;
+	geo.page_size = e->page_size;
+	geo.addr_len = e->type == EEPROM_TYPE_16BIT_ADDR ? 2 : 1;
+	geo.write_timeout_us = e->write_timeout_us;
+	r = i2c_eeprom_set_geometry(e->ee, &geo);
+	if(r < 0) {
+		fprintf(stderr, "Error: %s\n", r == -EINVAL ?
+			"bad eeprom geometry" : strerror(-r));
+		return -1;
+	}
+	return 0;
 }
 
-static int i2c_write_2b(struct eeprom *e, __u8 buf[2])
+static void update_stats(struct eeprom *e)
 {
-	int r;
-	// we must simulate a plain I2C byte write with SMBus functions
-	r = i2c_smbus_write_byte_data(e->fd, buf[0], buf[1]);
-	if(r < 0)
-		fprintf(stderr, "Error i2c_write_2b: %s\n", strerror(errno));
-	usleep(10);
-	return r;
+	struct i2c_eeprom_stats stats;
+
+	i2c_eeprom_get_stats(e->ee, &stats);
+	e->wc_count = stats.write_cycles;
+	e->wc_min_us = stats.min_us;
+	e->wc_max_us = stats.max_us;
+	e->wc_total_us = stats.total_us;
 }
 
-static int i2c_write_3b(struct eeprom *e, __u8 buf[3])
+static int report(const char *what, int r)
 {
-	int r;
-	// we must simulate a plain I2C byte write with SMBus functions
-	// the __u16 data field will be byte swapped by the SMBus protocol
-	r = i2c_smbus_write_word_data(e->fd, buf[0], buf[2] << 8 | buf[1]);
-	if(r < 0)
-		fprintf(stderr, "Error i2c_write_3b: %s\n", strerror(errno));
-	usleep(10);
-	return r;
+	if(r < 0) {
+		if(r == -ETIMEDOUT)
+			fprintf(stderr, "Error %s: write cycle not complete "
+				"in time\n", what);
+		else
+			fprintf(stderr, "Error %s: %s\n", what, strerror(-r));
+		return -1;
+	}
+	return 0;
 }
 
-
-#define CHECK_I2C_FUNC( var, label ) \
-	do { 	if(0 == (var & label)) { \
-		fprintf(stderr, "\nError: " \
-			#label " function is required. Program halted.\n\n"); \
-		exit(1); } \
-	} while(0);
-
 int eeprom_open(char *dev_fqn, int addr, int type, struct eeprom* e)
 {
-	int fd, r;
-	unsigned long funcs;
+	struct i2c_eeprom_geometry geo;
+	int fd;
 	e->fd = e->addr = 0;
 	e->dev = 0;
 	
 	fd = open(dev_fqn, O_RDWR);
-	if(fd <= 0)
+	if(fd < 0)
 		return -1;
 
-	// get funcs list
-	if((r = ioctl(fd, I2C_FUNCS, &funcs) < 0))
-		return r;
-
-	
-	// check for req funcs
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_READ_BYTE );
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_WRITE_BYTE );
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_READ_BYTE_DATA );
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_WRITE_BYTE_DATA );
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_READ_WORD_DATA );
-	CHECK_I2C_FUNC( funcs, I2C_FUNC_SMBUS_WRITE_WORD_DATA );
-
-	// set working device
-	if( ( r = ioctl(fd, I2C_SLAVE, addr)) < 0)
-		return r;
+	// smallest page size of the parts using this address mode, and
+	// what a single i2c address can hold
+	geo.size = type == EEPROM_TYPE_16BIT_ADDR ? 0x10000 : 0x100;
+	geo.page_size = type == EEPROM_TYPE_16BIT_ADDR ? 32 : 8;
+	geo.addr_len = type == EEPROM_TYPE_16BIT_ADDR ? 2 : 1;
+	geo.write_timeout_us = EEPROM_WRITE_TIMEOUT_US;
+	e->ee = i2c_eeprom_open(fd, addr, &geo);
+	if(!e->ee) {
+		if(errno == EOPNOTSUPP)
+			fprintf(stderr, "Error: the adapter lacks the "
+				"transactions needed to access an eeprom\n");
+		close(fd);
+		return -1;
+	}
 	e->fd = fd;
 	e->addr = addr;
 	e->dev = dev_fqn;
 	e->type = type;
+	e->page_size = geo.page_size;
+	e->size = geo.size;
+	e->part = 0;
+	e->write_timeout_us = geo.write_timeout_us;
+	update_stats(e);
 	return 0;
 }
 
 int eeprom_close(struct eeprom *e)
 {
+	i2c_eeprom_close(e->ee);
+	e->ee = 0;
 	close(e->fd);
 	e->fd = -1;
 	e->dev = 0;
@@ -111,73 +115,63 @@ int eeprom_close(struct eeprom *e)
 	return 0;
 }
 
-#if 0
-int eeprom_24c32_write_byte(struct eeprom *e, __u16 mem_addr, __u8 data)
+int eeprom_read_current_byte(struct eeprom* e)
 {
-	__u8 buf[3] = { (mem_addr >> 8) & 0x00ff, mem_addr & 0x00ff, data };
-	return i2c_write_3b(e, buf);
-}
+	__u8 byte;
 
+	if(eeprom_read_current_block(e, &byte, 1) < 0)
+		return -1;
+	return byte;
+}
 
-int eeprom_24c32_read_current_byte(struct eeprom* e)
+int eeprom_read_current_block(struct eeprom *e, __u8 *buf, int len)
 {
-	ioctl(e->fd, BLKFLSBUF); // clear kernel read buffer
-	return i2c_smbus_read_byte(e->fd);
+	return report("eeprom_read_current_block",
+		      i2c_eeprom_read_current(e->ee, buf, len));
 }
 
-int eeprom_24c32_read_byte(struct eeprom* e, __u16 mem_addr)
+int eeprom_read_byte(struct eeprom* e, unsigned mem_addr)
 {
-	int r;
-	ioctl(e->fd, BLKFLSBUF); // clear kernel read buffer
-	__u8 buf[2] = { (mem_addr >> 8) & 0x0ff, mem_addr & 0x0ff };
-	r = i2c_write_2b(e, buf);
-	if (r < 0)
-		return r;
-	r = i2c_smbus_read_byte(e->fd);
-	return r;
+	__u8 byte;
+
+	if(eeprom_read_block(e, mem_addr, &byte, 1) < 0)
+		return -1;
+	return byte;
 }
-#endif
 
+int eeprom_read_block(struct eeprom *e, unsigned mem_addr, __u8 *buf, int len)
+{
+	if(update_geometry(e) < 0)
+		return -1;
+	return report("eeprom_read_block",
+		      i2c_eeprom_read(e->ee, mem_addr, buf, len));
+}
 
-int eeprom_read_current_byte(struct eeprom* e)
+int eeprom_write_byte(struct eeprom *e, unsigned mem_addr, __u8 data)
 {
-	ioctl(e->fd, BLKFLSBUF); // clear kernel read buffer
-	return i2c_smbus_read_byte(e->fd);
+	return eeprom_write_page(e, mem_addr, &data, 1);
 }
 
-int eeprom_read_byte(struct eeprom* e, __u16 mem_addr)
+int eeprom_wait_ready(struct eeprom *e)
 {
 	int r;
-	ioctl(e->fd, BLKFLSBUF); // clear kernel read buffer
-	if(e->type == EEPROM_TYPE_8BIT_ADDR)
-	{
-		__u8 buf =  mem_addr & 0x0ff;
-		r = i2c_write_1b(e, buf);
-	} else if(e->type == EEPROM_TYPE_16BIT_ADDR) {
-		__u8 buf[2] = { (mem_addr >> 8) & 0x0ff, mem_addr & 0x0ff };
-		r = i2c_write_2b(e, buf);
-	} else {
-		fprintf(stderr, "ERR: unknown eeprom type\n");
-		return -1;
-	}
-	if (r < 0)
-		return r;
-	r = i2c_smbus_read_byte(e->fd);
+
+	r = report("eeprom_wait_ready", i2c_eeprom_sync(e->ee));
+	update_stats(e);
 	return r;
 }
 
-int eeprom_write_byte(struct eeprom *e, __u16 mem_addr, __u8 data)
+int eeprom_write_page(struct eeprom *e, unsigned mem_addr, const __u8 *data,
+		      int len)
 {
-	if(e->type == EEPROM_TYPE_8BIT_ADDR) {
-		__u8 buf[2] = { mem_addr & 0x00ff, data };
-		return i2c_write_2b(e, buf);
-	} else if(e->type == EEPROM_TYPE_16BIT_ADDR) {
-		__u8 buf[3] = 
-			{ (mem_addr >> 8) & 0x00ff, mem_addr & 0x00ff, data };
-		return i2c_write_3b(e, buf);
-	} else {
-		fprintf(stderr, "ERR: unknown eeprom type\n");
+	if(update_geometry(e) < 0)
+		return -1;
+	if(len <= 0 || mem_addr % e->page_size + len > (unsigned)e->page_size) {
+		fprintf(stderr, "ERR: write crosses a page boundary\n");
 		return -1;
 	}
+	if(report("eeprom_write_page",
+		  i2c_eeprom_write(e->ee, mem_addr, data, len)) < 0)
+		return -1;
+	return eeprom_wait_ready(e);
 }
-
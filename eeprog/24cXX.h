@@ -14,19 +14,54 @@
 #ifndef _24CXX_H_
 #define _24CXX_H_
 #include <linux/types.h>
+#include <i2c/eeprom.h>
 
 #define EEPROM_TYPE_UNKNOWN	0
 #define EEPROM_TYPE_8BIT_ADDR	1
 #define EEPROM_TYPE_16BIT_ADDR 	2
 
+#define EEPROM_MAX_PAGE_SIZE	I2C_EEPROM_MAX_PAGE_SIZE
+#define EEPROM_WRITE_TIMEOUT_US	I2C_EEPROM_WRITE_TIMEOUT_US
+// largest supported part, 24M02
+#define EEPROM_MAX_SIZE		0x40000
+
+struct eeprom_part
+{
+	const char *name;
+	int type;	// address mode
+	unsigned size;	// capacity in bytes, parts larger than 256 bytes
+			// in 8bit mode, or 64 KiB in 16bit mode, use several
+			// consecutive i2c addresses
+	int page_size;
+	int serial;	// has a read-only serial number at i2c address + 8
+};
+
+// known parts, terminated by an entry with a NULL name
+extern const struct eeprom_part eeprom_parts[];
+
 struct eeprom
 {
 	char *dev; 	// device file i.e. /dev/i2c-N
 	int addr;	// i2c address
 	int fd;		// file descriptor
 	int type; 	// eeprom type
+	int page_size;	// write page size, 1 for byte writes
+	unsigned size;	// capacity in bytes
+	const struct eeprom_part *part; // if known
+	struct i2c_eeprom *ee; // libi2c handle doing the transactions
+	unsigned write_timeout_us; // give up waiting for a write cycle after
+	// write cycle statistics, in microseconds
+	unsigned long wc_count, wc_min_us, wc_max_us;
+	unsigned long long wc_total_us;
 };
 
+/*
+ * The geometry fields of struct eeprom (type, page_size, size and
+ * write_timeout_us) can be changed between calls, they are passed on to
+ * the libi2c handle by each function below. Errors are reported on
+ * stderr.
+ */
+
 /*
  * opens the eeprom device at [dev_fqn] (i.e. /dev/i2c-N) whose address is
  * [addr] and set the eeprom_24c32 [e]
@@ -36,21 +71,61 @@ int eeprom_open(char *dev_fqn, int addr, int type, struct eeprom*);
  * closees the eeprom device [e] 
  */
 int eeprom_close(struct eeprom *e);
+/*
+ * returns the part called [name], or NULL
+ */
+const struct eeprom_part *eeprom_find_part(const char *name);
+/*
+ * sets the address mode and the geometry of [e] to those of [part]
+ */
+void eeprom_set_part(struct eeprom *e, const struct eeprom_part *part);
+/*
+ * guesses the part at the address of [e] and sets it, without writing to
+ * the eeprom. The capacity is found by reading the whole memory until it
+ * wraps around, so this fails on eeproms with uniform contents.
+ * Returns 0 on success.
+ */
+int eeprom_detect(struct eeprom *e);
+/*
+ * reads the 128-bit serial number of AT24CS parts into [serial].
+ * Returns 0 on success.
+ */
+int eeprom_read_serial(struct eeprom *e, __u8 serial[16]);
 /*
  * read and returns the eeprom byte at memory address [mem_addr] 
- * Note: eeprom must have been selected by ioctl(fd,I2C_SLAVE,address) 
  */
-int eeprom_read_byte(struct eeprom* e, __u16 mem_addr);
+int eeprom_read_byte(struct eeprom* e, unsigned mem_addr);
 /*
  * read the current byte
- * Note: eeprom must have been selected by ioctl(fd,I2C_SLAVE,address) 
  */
 int eeprom_read_current_byte(struct eeprom *e);
 /*
- * writes [data] at memory address [mem_addr] 
- * Note: eeprom must have been selected by ioctl(fd,I2C_SLAVE,address) 
+ * reads [len] bytes from the current address into [buf]
+ */
+int eeprom_read_current_block(struct eeprom *e, __u8 *buf, int len);
+/*
+ * reads [len] bytes from memory address [mem_addr] into [buf], with as
+ * few transactions as the adapter allows. Returns 0 on success.
+ */
+int eeprom_read_block(struct eeprom *e, unsigned mem_addr, __u8 *buf, int len);
+/*
+ * writes [data] at memory address [mem_addr], and waits for the write
+ * cycle to complete
+ */
+int eeprom_write_byte(struct eeprom *e, unsigned mem_addr, __u8 data);
+/*
+ * writes [len] bytes of [data] at memory address [mem_addr] in a single
+ * page write, and waits for the write cycle to complete. The bytes must
+ * not cross a page boundary of [e]->page_size bytes.
+ */
+int eeprom_write_page(struct eeprom *e, unsigned mem_addr, const __u8 *data,
+		      int len);
+/*
+ * waits for the end of a write cycle, by polling the eeprom until it
+ * acknowledges its address again, for at most [e]->write_timeout_us.
+ * The time taken is accounted in the write cycle statistics of [e].
  */
-int eeprom_write_byte(struct eeprom *e, __u16 mem_addr, __u8 data);
+int eeprom_wait_ready(struct eeprom *e);
 
 #endif
 
@@ -13,6 +13,7 @@ EEPROG_LDFLAGS	:= $(LIB_DIR)/$(LIB_STLIBNAME)
 else
 EEPROG_LDFLAGS	:= -L$(LIB_DIR) -li2c
 endif
+EEPROG_LDFLAGS	+= -pthread
 
 EEPROG_TARGETS	:= eeprog
 
@@ -20,17 +21,36 @@ EEPROG_TARGETS	:= eeprog
 # Programs
 #
 
-$(EEPROG_DIR)/eeprog: $(EEPROG_DIR)/eeprog.o $(EEPROG_DIR)/24cXX.o
+$(EEPROG_DIR)/eeprog: $(EEPROG_DIR)/eeprog.o $(EEPROG_DIR)/24cXX.o $(EEPROG_DIR)/image.o \
+		       $(EEPROG_DIR)/parts.o $(EEPROG_DIR)/gang.o $(EEPROG_DIR)/hash.o \
+		       $(EEPROG_DIR)/journal.o
 	$(CC) $(LDFLAGS) -o $@ $^ $(EEPROG_LDFLAGS)
 
 #
 # Objects
 #
 
-$(EEPROG_DIR)/eeprog.o: $(EEPROG_DIR)/eeprog.c $(EEPROG_DIR)/24cXX.h
+$(EEPROG_DIR)/eeprog.o: $(EEPROG_DIR)/eeprog.c $(EEPROG_DIR)/24cXX.h $(EEPROG_DIR)/image.h \
+		       $(EEPROG_DIR)/gang.h $(EEPROG_DIR)/hash.h $(EEPROG_DIR)/journal.h
 	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
 
-$(EEPROG_DIR)/24cXX.o: $(EEPROG_DIR)/24cXX.c $(EEPROG_DIR)/24cXX.h $(INCLUDE_DIR)/i2c/smbus.h
+$(EEPROG_DIR)/24cXX.o: $(EEPROG_DIR)/24cXX.c $(EEPROG_DIR)/24cXX.h $(INCLUDE_DIR)/i2c/eeprom.h
+	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
+
+$(EEPROG_DIR)/parts.o: $(EEPROG_DIR)/parts.c $(EEPROG_DIR)/24cXX.h $(INCLUDE_DIR)/i2c/smbus.h \
+		       $(INCLUDE_DIR)/i2c/eeprom.h
+	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
+
+$(EEPROG_DIR)/gang.o: $(EEPROG_DIR)/gang.c $(EEPROG_DIR)/gang.h $(EEPROG_DIR)/24cXX.h
+	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -pthread -c $< -o $@
+
+$(EEPROG_DIR)/hash.o: $(EEPROG_DIR)/hash.c $(EEPROG_DIR)/hash.h
+	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
+
+$(EEPROG_DIR)/journal.o: $(EEPROG_DIR)/journal.c $(EEPROG_DIR)/journal.h
+	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
+
+$(EEPROG_DIR)/image.o: $(EEPROG_DIR)/image.c $(EEPROG_DIR)/image.h
 	$(CC) $(CFLAGS) $(EEPROG_CFLAGS) -c $< -o $@
 
 #
@@ -18,16 +18,30 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "24cXX.h"
+#include "image.h"
+#include "gang.h"
+#include "hash.h"
+#include "journal.h"
 
 #define VERSION 	"0.7.5"
 
+// bytes read at once by --verify and --hash
+#define CHUNK_SIZE	8192
+// mismatches listed by --verify
+#define VERIFY_MAX_REPORT	16
+// bytes written between two journal updates
+#define JOURNAL_BATCH	4096
+
 #define ENV_DEV		"EEPROG_DEV"
 #define ENV_I2C_ADDR	"EEPROG_I2C_ADDR"
 
 int g_quiet;
+// exit status on error, 2 with --verify like cmp
+int g_fail_status = 1;
 
 #define usage_if(a) do { do_usage_if( a , __LINE__); } while(0);
 void do_usage_if(int b, int line)
@@ -35,21 +49,49 @@ void do_usage_if(int b, int line)
 	static const char *eeprog_usage =
 "eeprog " VERSION ", a 24Cxx EEPROM reader/writer\n"
 "Copyright (c) 2003 by Stefano Barbato - All rights reserved.\n"
-"Usage: eeprog [-fqxdh] [-16|-8] [ -r addr[:count] | -w addr ]  /dev/i2c-N  i2c-address\n" 
+"Usage: eeprog [-fqxdh] [-16|-8|--part name|--detect] [-p size] [-t ms] [-F format]\n"
+"	[ -r addr[:count] [-o file] | -w addr[:count] [-i file] [--diff] ]\n"
+"	/dev/i2c-N  i2c-address\n" 
 "\n"
 "  Address modes:\n"
 "	-8		Use 8bit address mode for 24c0x...24C16 [default]\n"
 "	-16		Use 16bit address mode for 24c32...24C256\n"
+"	--part name	Use the address mode and geometry of part [name]\n"
+"	--detect	Detect the address mode and geometry, without\n"
+"			writing to the EEPROM\n"
 "  Actions:\n"
+"	--detect	Alone, just report the detected part\n"
+"	--verify file	Compare the EEPROM with [file], exit status 0 if\n"
+"			they match, 1 if they differ, 2 on error\n"
+"	--hash algo	With -r, or alone for the whole EEPROM, print the\n"
+"			crc32 or sha256 hash of the contents\n"
 "	-r addr[:count]	Read [count] (1 if omitted) bytes from [addr]\n" 
 "			and print them to the standard output\n" 
-"	-w addr		Write input (stdin) at address [addr] of the EEPROM\n"
+"	-w addr[:count]	Write input (stdin), at most [count] bytes of it,\n"
+"			at address [addr] of the EEPROM\n"
+"	--journal file	With -w, record the progress in [file], which is\n"
+"			deleted once the write is complete\n"
+"	--resume	With --journal, skip what was already written\n"
+"	--gang list	With -w, write and verify all the EEPROMs listed\n"
+"			in file [list], one \"/dev/i2c-N i2c-address\" per\n"
+"			line, in parallel on different buses\n"
+"	--diff		With -w, only write the pages which differ, and\n"
+"			verify them\n"
 "	-h		Print this help\n"
 "  Options:\n"
 "	-x		Set hex output mode\n" 
+"	-i file		Read the input from [file] instead of stdin\n"
+"	--skip offset	With -w, skip the first [offset] bytes of the\n"
+"			input\n"
+"	-o file		Write the output to [file] instead of stdout\n"
+"	-F format	Input and output format, raw [default] or ihex\n"
+"			(Intel HEX)\n"
 "	-d		Dummy mode, display what *would* have been done\n" 
 "	-f		Disable warnings and don't ask confirmation\n"
 "	-q		Quiet mode\n"
+"	-p size		Write page size, 1 for byte writes [default: 8 in\n"
+"			8bit address mode, 32 in 16bit address mode]\n"
+"	-t ms		Write cycle timeout [default: 25]\n"
 "\n"
 "The following environment variables could be set instead of the command\n"
 "line arguments:\n"
@@ -70,7 +112,7 @@ void do_usage_if(int b, int line)
 	if(!b)
 		return;
 	fprintf(stderr, "%s\n[line %d]\n", eeprog_usage, line);
-	exit(1);
+	exit(g_fail_status);
 }
 
 
@@ -81,7 +123,7 @@ void do_die_if(int b, char* msg, int line)
 		return;
 	fprintf(stderr, "Error at line %d: %s\n", line, msg);
 	//fprintf(stderr, "	sysmsg: %s\n", strerror(errno));
-	exit(1);
+	exit(g_fail_status);
 }
 
 #define print_info(args...) do { if(!g_quiet) fprintf(stderr, args); } while(0);
@@ -94,6 +136,17 @@ void parse_arg(char *arg, int* paddr, int *psize)
 		*psize = strtoul(++end, 0, 0);
 }
 
+void list_parts()
+{
+	const struct eeprom_part *p;
+
+	fprintf(stderr, "Unknown part, the known parts are:\n");
+	for(p = eeprom_parts; p->name; p++)
+		fprintf(stderr, "	%-10s %7u bytes, %3d byte pages%s\n", p->name,
+			p->size, p->page_size, p->serial ? ", serial number" : "");
+	exit(g_fail_status);
+}
+
 int confirm_action()
 {
 	fprintf(stderr, 
@@ -117,64 +170,328 @@ int confirm_action()
 }
 
 
-int read_from_eeprom(struct eeprom *e, int addr, int size, int hex)
+int read_from_eeprom(struct eeprom *e, int addr, int size, int format,
+		     char *path)
 {
+	__u8 *buf;
 
-	int ch, i;
-	// hex print out
-	die_if((ch = eeprom_read_byte(e, addr)) < 0, "read error");
-	i = 1;
-	if(hex)
-		printf("\n %.4x|  %.2x ", addr, ch);
-	else
-		putchar(ch);
-	while(--size)
+	die_if(size < 1 || addr < 0 || (unsigned)(addr + size) > e->size,
+	       "invalid read range");
+	die_if(!(buf = malloc(size)), "out of memory");
+	die_if(eeprom_read_block(e, addr, buf, size), "read error");
+	die_if(image_save(path, format, addr, buf, size),
+	       "unable to write the output file");
+	free(buf);
+	return 0;
+}
+
+void print_write_cycles(struct eeprom *e)
+{
+	if(e->wc_count)
+		print_info("  Write cycles: %lu, min %lu us, avg %llu us, "
+			"max %lu us\n", e->wc_count, e->wc_min_us,
+			e->wc_total_us / e->wc_count, e->wc_max_us);
+}
+
+// bytes to write at addr before the next page boundary
+int page_chunk(struct eeprom *e, int addr, int len)
+{
+	int plen = e->page_size - addr % e->page_size;
+	return plen < len ? plen : len;
+}
+
+int write_to_eeprom(struct eeprom *e, int addr, const __u8 *buf, int len)
+{
+	int plen;
+	// one write cycle per page, pages are aligned
+	for(; len > 0; addr += plen, buf += plen, len -= plen)
 	{
-		die_if((ch = eeprom_read_current_byte(e)) < 0, "read error");
-		if(hex)
+		plen = page_chunk(e, addr, len);
+		print_info(".");
+		die_if(eeprom_write_page(e, addr, buf, plen), "write error");
+	}
+	print_info("\n\n");
+	print_write_cycles(e);
+	return 0;
+}
+
+int diff_write_to_eeprom(struct eeprom *e, int addr, const __u8 *in, int len)
+{
+	__u8 *cur, *dirty;
+	int off, end, plen, written = 0, skipped = 0;
+
+	die_if(!(cur = malloc(len + 1)) || !(dirty = calloc(1, len + 1)),
+	       "out of memory");
+	if(len)
+		die_if(eeprom_read_block(e, addr, cur, len), "read error");
+
+	// compare page by page and only write the pages which differ
+	for(off = 0; off < len; off += plen)
+	{
+		plen = page_chunk(e, addr + off, len - off);
+		if(!memcmp(in + off, cur + off, plen))
 		{
-			addr++;
-			if( (i % 16) == 0 ) 
-				printf("\n %.4x|  ", addr);
-			else if( (i % 8) == 0 ) 
-				printf("  ");
-			i++;
-			printf("%.2x ", ch);
-		} else {
-			putchar(ch);
+			skipped++;
+			continue;
 		}
+		print_info(".");
+		die_if(eeprom_write_page(e, addr + off, in + off, plen),
+		       "write error");
+		memset(dirty + off, 1, plen);
+		written++;
+	}
+	print_info("\n\n  Pages written: %d, skipped: %d\n", written, skipped);
+
+	// read back the rewritten pages, one run of consecutive pages at once
+	for(off = 0; off < len; off = end)
+	{
+		for(end = off; end < len && dirty[end] == dirty[off]; end++)
+			;
+		if(!dirty[off])
+			continue;
+		die_if(eeprom_read_block(e, addr + off, cur + off, end - off),
+		       "read error");
+		die_if(memcmp(in + off, cur + off, end - off),
+		       "verify error");
 	}
-	if(hex)
-		printf("\n\n");
-	fflush(stdout);
+	if(written)
+		print_info("  Rewritten pages verified\n");
+	print_write_cycles(e);
+	free(cur);
+	free(dirty);
 	return 0;
 }
 
-int write_to_eeprom(struct eeprom *e, int addr)
+// like write_to_eeprom, skipping what the journal says is done, and
+// verifying and recording batches of pages as they are written
+int journal_write_to_eeprom(struct eeprom *e, int addr, const __u8 *buf,
+			    int len, struct journal *j)
 {
-	int c;
-	while((c = getchar()) != EOF)
+	__u8 cur[JOURNAL_BATCH];
+	int off, end, plen, written = 0, skipped = 0;
+
+	for(off = 0; off < len; off = end)
 	{
-		print_info(".");
-		fflush(stdout);
-		die_if(eeprom_write_byte(e, addr++, c), "write error");
+		plen = page_chunk(e, addr + off, len - off);
+		if(!memchr(j->done + off, 0, plen))
+		{
+			skipped++;
+			end = off + plen;
+			continue;
+		}
+		// pages partly done are written again, the first one is
+		// never fully done, so that end always moves forward
+		for(end = off; end < len; end += plen)
+		{
+			plen = page_chunk(e, addr + end, len - end);
+			if(!memchr(j->done + end, 0, plen))
+				break;
+			if(end > off && end - off + plen > JOURNAL_BATCH)
+				break;
+			print_info(".");
+			die_if(eeprom_write_page(e, addr + end, buf + end, plen),
+			       "write error");
+			written++;
+		}
+		die_if(eeprom_read_block(e, addr + off, cur, end - off),
+		       "read error");
+		die_if(memcmp(cur, buf + off, end - off), "verify error");
+		die_if(journal_add(j, off, end - off),
+		       "unable to update the journal");
 	}
-	print_info("\n\n");
+	print_info("\n\n  Pages written: %d, skipped: %d\n", written, skipped);
+	print_write_cycles(e);
+	return 0;
+}
+
+void open_journal(struct journal *j, char *path, int resume,
+		  struct eeprom *e, int addr, const __u8 *buf, int len)
+{
+	struct sha256 sha;
+	__u8 digest[32];
+	char header[256];
+	int i, n, ret;
+
+	// the journal is only valid for the same image at the same place,
+	// written with the same page size, as ranges follow the pages
+	sha256_init(&sha);
+	sha256_update(&sha, buf, len);
+	sha256_final(&sha, digest);
+	n = sprintf(header, "eeprog-journal 2 ");
+	for(i = 0; i < 32; i++)
+		n += sprintf(header + n, "%02x", digest[i]);
+	snprintf(header + n, sizeof(header) - n, " %s 0x%02x 0x%x %d %d",
+		 e->dev, e->addr, addr, len, e->page_size);
+
+	ret = journal_open(j, path, header, len, resume);
+	die_if(ret == -ESTALE, "the journal is for another write");
+	die_if(ret, "unable to open the journal");
+}
+
+// exit status 1 on mismatch, like cmp, 2 on error
+int verify_eeprom(struct eeprom *e, char *path, int format)
+{
+	struct image img;
+	__u8 *buf;
+	int ret, off, n, i;
+	unsigned long diffs = 0;
+
+	ret = image_load(path, format, e->size, &img);
+	if(ret)
+	{
+		fprintf(stderr, "Error: %s: %s\n", path,
+			ret == -EINVAL ? "invalid Intel HEX input" :
+			ret == -EFBIG ? "larger than the EEPROM" :
+			strerror(-ret));
+		exit(2);
+	}
+	if(!(buf = malloc(CHUNK_SIZE)))
+		exit(2);
+	print_info("  Verifying %d bytes from 0x%x against %s\n", img.len,
+		img.start, path);
+	for(off = 0; off < img.len; off += n)
+	{
+		n = img.len - off < CHUNK_SIZE ? img.len - off : CHUNK_SIZE;
+		if(eeprom_read_block(e, img.start + off, buf, n))
+		{
+			fprintf(stderr, "Error: read error at 0x%x\n",
+				img.start + off);
+			exit(2);
+		}
+		if(!memcmp(buf, img.data + off, n))
+			continue;
+		for(i = 0; i < n; i++)
+		{
+			if(buf[i] == img.data[off + i])
+				continue;
+			if(diffs++ < VERIFY_MAX_REPORT)
+				printf("0x%05x: 0x%02x, expected 0x%02x\n",
+					img.start + off + i, buf[i],
+					img.data[off + i]);
+		}
+	}
+	if(diffs > VERIFY_MAX_REPORT)
+		printf("...\n");
+	if(diffs)
+		printf("%lu of %d bytes differ\n", diffs, img.len);
+	else
+		print_info("  Contents match\n");
+	free(buf);
+	image_free(&img);
+	return diffs ? 1 : 0;
+}
+
+// exit status 2 on error
+int hash_eeprom(struct eeprom *e, int addr, int size, char *algo)
+{
+	struct sha256 sha;
+	__u8 buf[CHUNK_SIZE], digest[32];
+	__u32 crc = 0;
+	int off, n, i;
+
+	die_if(size < 1 || addr < 0 || (unsigned)(addr + size) > e->size,
+	       "invalid read range");
+	sha256_init(&sha);
+	for(off = 0; off < size; off += n)
+	{
+		n = size - off < CHUNK_SIZE ? size - off : CHUNK_SIZE;
+		if(eeprom_read_block(e, addr + off, buf, n))
+		{
+			fprintf(stderr, "Error: read error at 0x%x\n",
+				addr + off);
+			exit(2);
+		}
+		if(!strcmp(algo, "crc32"))
+			crc = crc32_update(crc, buf, n);
+		else
+			sha256_update(&sha, buf, n);
+	}
+	if(!strcmp(algo, "crc32"))
+	{
+		printf("%08x", crc);
+	} else {
+		sha256_final(&sha, digest);
+		for(i = 0; i < 32; i++)
+			printf("%02x", digest[i]);
+	}
+	printf("  %s:0x%02x:0x%x+%d\n", e->dev, e->addr, addr, size);
 	return 0;
 }
 
+void load_image(char *path, int format, int max, int skip,
+		struct image *img)
+{
+	int ret = image_load(path, format, max + skip, img);
+	die_if(ret == -EINVAL, "invalid Intel HEX input");
+	die_if(ret == -EFBIG, "input larger than the EEPROM");
+	die_if(ret, "unable to read the input file");
+	image_skip(img, skip);
+}
+
+int gang_write_to_eeproms(char *list, struct gang_options *opt, char *arg,
+			  char *in_path, int format, int skip)
+{
+	struct image img;
+	int memaddr, size = EEPROM_MAX_SIZE, ret;
+
+	parse_arg(arg, &memaddr, &size);
+	die_if(memaddr < 0 || memaddr >= EEPROM_MAX_SIZE,
+	       "invalid write address");
+	load_image(in_path, format, EEPROM_MAX_SIZE - memaddr, skip, &img);
+	opt->data = img.data;
+	opt->len = size < img.len ? size : img.len;
+	opt->mem_addr = memaddr + img.start;
+	print_info("  Writing %d bytes of %s starting at address 0x%x to the "
+		"targets of %s\n", opt->len, in_path ? in_path : "stdin",
+		opt->mem_addr, list);
+	ret = gang_program(list, opt);
+	image_free(&img);
+	die_if(ret < 0, "unable to read the target list");
+	return ret;
+}
+
 int main(int argc, char** argv)
 {
 	struct eeprom e;
-	int ret, op, i2c_addr, memaddr, size, want_hex, dummy, force, sixteen;
-	char *device, *arg = 0, *i2c_addr_s;
+	int ret, op, i2c_addr, memaddr, size, want_hex, dummy, force, sixteen, i;
+	char *device, *arg = 0, *i2c_addr_s, *in_path = 0, *out_path = 0;
 	struct stat st;
-	int eeprom_type = 0;
+	struct image img;
+	int eeprom_type = 0, page_size = 0, write_timeout = 0, diff = 0;
+	int format = IMAGE_FORMAT_RAW, detect = 0;
+	const struct eeprom_part *part = 0;
+	struct gang_options gang = { 0 };
+	char *gang_list = 0, *hash = 0, *journal_path = 0;
+	struct journal journal;
+	int resume = 0, skip = 0;
+	__u8 serial[16];
+	static const struct option long_options[] = {
+		{ "diff", no_argument, 0, 'D' },
+		{ "part", required_argument, 0, 'P' },
+		{ "detect", no_argument, 0, 'E' },
+		{ "gang", required_argument, 0, 'G' },
+		{ "verify", required_argument, 0, 'V' },
+		{ "hash", required_argument, 0, 'H' },
+		{ "journal", required_argument, 0, 'J' },
+		{ "resume", no_argument, 0, 'R' },
+		{ "skip", required_argument, 0, 'S' },
+		{ 0, 0, 0, 0 }
+	};
 
 	op = want_hex = dummy = force = sixteen = 0;
 	g_quiet = 0;
 
-	while((ret = getopt(argc, argv, "1:8fr:qhw:xd")) != -1)
+	// look for --verify first, so that all the errors exit with 2
+	opterr = 0;
+	while((ret = getopt_long(argc, argv, "1:8fr:qhw:xdp:t:i:o:F:",
+				  long_options, 0)) != -1)
+		if(ret == 'V')
+			g_fail_status = 2;
+	opterr = 1;
+	optind = 0;
+
+	while((ret = getopt_long(argc, argv, "1:8fr:qhw:xdp:t:i:o:F:",
+				  long_options, 0)) != -1)
 	{
 		switch(ret)
 		{
@@ -202,16 +519,97 @@ int main(int argc, char** argv)
 		case 'h':
 			usage_if(1);
 			break;
+		case 'p':
+			page_size = strtoul(optarg, 0, 0);
+			die_if(page_size < 1 || page_size > EEPROM_MAX_PAGE_SIZE
+			       || (page_size & (page_size - 1)),
+			       "page size must be a power of 2 up to 256");
+			break;
+		case 'D':
+			diff++;
+			break;
+		case 'P':
+			if(!(part = eeprom_find_part(optarg)))
+				list_parts();
+			break;
+		case 'E':
+			detect++;
+			break;
+		case 'G':
+			gang_list = optarg;
+			break;
+		case 'J':
+			journal_path = optarg;
+			break;
+		case 'R':
+			resume++;
+			break;
+		case 'S':
+			skip = strtoul(optarg, 0, 0);
+			die_if(skip < 0 || skip > INT_MAX - EEPROM_MAX_SIZE,
+			       "invalid input offset");
+			break;
+		case 'H':
+			usage_if(strcmp(optarg, "crc32") &&
+				 strcmp(optarg, "sha256"));
+			hash = optarg;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		case 'F':
+			if(!strcmp(optarg, "raw"))
+				format = IMAGE_FORMAT_RAW;
+			else if(!strcmp(optarg, "ihex"))
+				format = IMAGE_FORMAT_IHEX;
+			else
+				usage_if(1);
+			break;
+		case 't':
+			write_timeout = strtoul(optarg, 0, 0);
+			die_if(write_timeout < 1 || write_timeout > 1000,
+			       "write cycle timeout must be 1 to 1000 ms");
+			break;
 		default:
 			die_if(op != 0, "Both read and write requested"); 
 			arg = optarg;
 			op = ret;
 		}
 	}
+	die_if(part && detect, "--part and --detect can't be used together");
+	die_if(part && eeprom_type && eeprom_type != part->type,
+	       "-8 or -16 doesn't match the part");
+	die_if(detect && eeprom_type, "-8 or -16 can't be used with --detect");
+	if(part)
+		eeprom_type = part->type;
 	if(!eeprom_type)
 		eeprom_type = EEPROM_TYPE_8BIT_ADDR; // default
 
-	usage_if(op == 0); // no switches 
+	usage_if(op == 0 && !detect && !hash); // no switches 
+	usage_if(hash && op != 0 && op != 'r');
+	usage_if(resume && !journal_path);
+	usage_if(journal_path && (op != 'w' || diff || gang_list));
+	usage_if(skip && op != 'w');
+	if(gang_list)
+	{
+		usage_if(op != 'w' || diff || argc != optind);
+		if(force == 0)
+			confirm_action();
+		gang.type = eeprom_type;
+		gang.part = part;
+		gang.detect = detect;
+		gang.page_size = page_size;
+		gang.write_timeout_us = write_timeout * 1000;
+		return gang_write_to_eeproms(gang_list, &gang, arg, in_path,
+					     format, skip) ? 1 : 0;
+	}
+	usage_if(diff && op != 'w');
+	usage_if((in_path && op != 'w') || (out_path && op != 'r'));
+	die_if(want_hex && format != IMAGE_FORMAT_RAW,
+	       "-x and -F can't be used together");
 	// set device and i2c_addr reading from cmdline or env
 	device = i2c_addr_s = 0;
 	switch(argc - optind)
@@ -242,9 +640,14 @@ int main(int argc, char** argv)
 
 	print_info("eeprog %s, a 24Cxx EEPROM reader/writer\n", VERSION);
 	print_info("Copyright (c) 2003 by Stefano Barbato - All rights reserved.\n");
-	print_info("  Bus: %s, Address: 0x%x, Mode: %dbit\n", 
+	if(detect) {
+		print_info("  Bus: %s, Address: 0x%x, Mode: autodetect\n",
+			device, i2c_addr);
+	} else {
+		print_info("  Bus: %s, Address: 0x%x, Mode: %dbit\n", 
 			device, i2c_addr, 
 			(eeprom_type == EEPROM_TYPE_8BIT_ADDR ? 8 : 16) );
+	}
 	if(dummy)
 	{
 		fprintf(stderr, "Dummy mode selected, nothing done.\n");
@@ -252,30 +655,87 @@ int main(int argc, char** argv)
 	}
 	die_if(eeprom_open(device, i2c_addr, eeprom_type, &e) < 0, 
 			"unable to open eeprom device file (check that the file exists and that it's readable)");
+	if(part)
+		eeprom_set_part(&e, part);
+	if(detect)
+	{
+		die_if(eeprom_detect(&e), "unable to detect the eeprom");
+		print_info("  Detected: %s, %u bytes, %d byte pages, %dbit mode\n",
+			e.part->name, e.size, e.page_size,
+			(e.type == EEPROM_TYPE_8BIT_ADDR ? 8 : 16));
+	}
+	if(e.part && e.part->serial && !eeprom_read_serial(&e, serial))
+	{
+		print_info("  Serial number: ");
+		for(i = 0; i < 16; i++)
+			print_info("%02x", serial[i]);
+		print_info("\n");
+	}
+	if(page_size)
+		e.page_size = page_size;
+	if(write_timeout)
+		e.write_timeout_us = write_timeout * 1000;
 	switch(op)
 	{
+	case 0: // detection or hash of the whole eeprom only
+		if(!hash)
+			break;
+		if(force == 0)
+			confirm_action();
+		hash_eeprom(&e, 0, e.size, hash);
+		break;
+	case 'V':
+		if(force == 0)
+			confirm_action();
+		ret = verify_eeprom(&e, arg, format);
+		break;
 	case 'r':
 		if(force == 0)
 			confirm_action();
 		size = 1; // default
 		parse_arg(arg, &memaddr, &size);
 		print_info("  Reading %d bytes from 0x%x\n", size, memaddr);
-		read_from_eeprom(&e, memaddr, size, want_hex);
+		if(hash)
+			hash_eeprom(&e, memaddr, size, hash);
+		else
+			read_from_eeprom(&e, memaddr, size, want_hex ?
+					 IMAGE_FORMAT_DUMP : format, out_path);
 		break;
 	case 'w':
 		if(force == 0)
 			confirm_action();
+		size = e.size; // default, the whole input
 		parse_arg(arg, &memaddr, &size);
-		print_info("  Writing stdin starting at address 0x%x\n", 
-			memaddr);
-		write_to_eeprom(&e, memaddr);
+		die_if(memaddr < 0 || (unsigned)memaddr >= e.size,
+		       "invalid write address");
+		load_image(in_path, format, e.size - memaddr, skip, &img);
+		// Intel HEX record addresses are relative to addr
+		memaddr += img.start;
+		if(size > img.len)
+			size = img.len;
+		print_info("  Writing %d bytes of %s starting at address 0x%x, "
+			"%d byte pages\n", size, in_path ? in_path : "stdin",
+			memaddr, e.page_size);
+		if(journal_path)
+		{
+			open_journal(&journal, journal_path, resume, &e,
+				     memaddr, img.data, size);
+			journal_write_to_eeprom(&e, memaddr, img.data, size,
+						&journal);
+			journal_close(&journal, 1);
+		} else if(diff) {
+			diff_write_to_eeprom(&e, memaddr, img.data, size);
+		} else {
+			write_to_eeprom(&e, memaddr, img.data, size);
+		}
+		image_free(&img);
 		break;
 	default:
 		usage_if(1);
-		exit(1);
+		exit(g_fail_status);
 	}
 	eeprom_close(&e);
 
-	return 0;
+	return op == 'V' ? ret : 0;
 }
 
@@ -0,0 +1,247 @@
+/*
+    gang.c - Programming many EEPROMs in parallel
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gang.h"
+
+enum { PASS, OPEN_FAILED, DETECT_FAILED, TOO_LARGE, WRITE_FAILED,
+       VERIFY_FAILED };
+
+static const char *status_names[] = {
+	"pass", "open failed", "detection failed", "image too large",
+	"write failed", "verify failed",
+};
+
+struct target {
+	char *dev;
+	dev_t rdev;		/* Device number, 0 if not a device file */
+	int addr;
+	int status;
+	double seconds;
+	unsigned long wc_count;
+	struct target *next_on_bus;
+};
+
+struct bus {
+	struct target *first;
+	const struct gang_options *opt;
+	pthread_t thread;
+	int started;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int program(struct target *t, const struct gang_options *opt)
+{
+	struct eeprom e;
+	__u8 *buf;
+	int off, n;
+
+	if (eeprom_open(t->dev, t->addr, opt->part ? opt->part->type :
+			opt->type, &e) < 0)
+		return OPEN_FAILED;
+	if (opt->part)
+		eeprom_set_part(&e, opt->part);
+	if (opt->detect && eeprom_detect(&e)) {
+		eeprom_close(&e);
+		return DETECT_FAILED;
+	}
+	if (opt->page_size)
+		e.page_size = opt->page_size;
+	if (opt->write_timeout_us)
+		e.write_timeout_us = opt->write_timeout_us;
+	if ((unsigned)(opt->mem_addr + opt->len) > e.size) {
+		eeprom_close(&e);
+		return TOO_LARGE;
+	}
+
+	/* Page writes, each followed by polling for the end of the write
+	   cycle, then a bulk read back */
+	for (off = 0; off < opt->len; off += n) {
+		n = e.page_size - (opt->mem_addr + off) % e.page_size;
+		if (n > opt->len - off)
+			n = opt->len - off;
+		if (eeprom_write_page(&e, opt->mem_addr + off,
+				      opt->data + off, n)) {
+			eeprom_close(&e);
+			return WRITE_FAILED;
+		}
+	}
+	t->wc_count = e.wc_count;
+
+	buf = malloc(opt->len + 1);
+	if (!buf || eeprom_read_block(&e, opt->mem_addr, buf, opt->len) ||
+	    memcmp(buf, opt->data, opt->len)) {
+		free(buf);
+		eeprom_close(&e);
+		return VERIFY_FAILED;
+	}
+	free(buf);
+	eeprom_close(&e);
+	return PASS;
+}
+
+/* Links and device nodes in other directories alias a bus, so compare
+   the device numbers, and the paths only if they aren't known */
+static int same_bus(const struct target *a, const struct target *b)
+{
+	if (a->rdev || b->rdev)
+		return a->rdev == b->rdev;
+	return !strcmp(a->dev, b->dev);
+}
+
+/* The targets of a bus are programmed one after the other */
+static void *bus_worker(void *arg)
+{
+	struct bus *b = arg;
+	struct target *t;
+	double start;
+
+	for (t = b->first; t; t = t->next_on_bus) {
+		start = now();
+		t->status = program(t, b->opt);
+		t->seconds = now() - start;
+	}
+	return NULL;
+}
+
+static int load_targets(const char *path, struct target **targets)
+{
+	char line[256], dev[256];
+	struct target *t = NULL, *p;
+	struct stat st;
+	int n = 0, size = 0, lineno = 0;
+	unsigned addr;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (line[strspn(line, " \t\r\n")] == '\0' ||
+		    line[strspn(line, " \t")] == '#')
+			continue;
+		if (sscanf(line, "%255s %i", dev, &addr) != 2 ||
+		    addr < 0x03 || addr > 0x77) {
+			fprintf(stderr, "%s:%d: expected \"device address\"\n",
+				path, lineno);
+			goto fail;
+		}
+		if (n == size) {
+			size = size ? 2 * size : 16;
+			p = realloc(t, size * sizeof(*t));
+			if (!p)
+				goto fail;
+			t = p;
+		}
+		memset(&t[n], 0, sizeof(*t));
+		t[n].addr = addr;
+		if (!(t[n].dev = strdup(dev)))
+			goto fail;
+		/* The target fails to open later if stat() fails */
+		if (stat(dev, &st) == 0 && S_ISCHR(st.st_mode))
+			t[n].rdev = st.st_rdev;
+		n++;
+	}
+	fclose(f);
+	if (!n)
+		fprintf(stderr, "%s: no targets\n", path);
+	*targets = t;
+	return n;
+
+fail:
+	fclose(f);
+	while (n--)
+		free(t[n].dev);
+	free(t);
+	return -1;
+}
+
+int gang_program(const char *path, const struct gang_options *opt)
+{
+	struct target *targets, **last;
+	struct bus *buses;
+	int n, nbuses = 0, i, j, failed = 0;
+	double start;
+
+	n = load_targets(path, &targets);
+	if (n <= 0)
+		return -1;
+
+	/* One bus per device, in order of first appearance */
+	buses = calloc(n, sizeof(*buses));
+	if (!buses) {
+		failed = -1;
+		goto out;
+	}
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < nbuses; j++)
+			if (same_bus(buses[j].first, &targets[i]))
+				break;
+		if (j == nbuses) {
+			buses[nbuses].first = &targets[i];
+			buses[nbuses++].opt = opt;
+			continue;
+		}
+		for (last = &buses[j].first; *last; last = &(*last)->next_on_bus)
+			;
+		*last = &targets[i];
+	}
+
+	start = now();
+	for (j = 0; j < nbuses; j++) {
+		if (!pthread_create(&buses[j].thread, NULL, bus_worker,
+				    &buses[j]))
+			buses[j].started = 1;
+		else
+			bus_worker(&buses[j]);	/* Do it ourselves */
+	}
+	for (j = 0; j < nbuses; j++)
+		if (buses[j].started)
+			pthread_join(buses[j].thread, NULL);
+
+	printf("%-20s %-7s %-18s %9s %12s\n", "Device", "Address", "Result",
+	       "Time (s)", "Write cycles");
+	for (i = 0; i < n; i++) {
+		printf("%-20s 0x%02x    %-18s %9.3f %12lu\n", targets[i].dev,
+		       targets[i].addr, status_names[targets[i].status],
+		       targets[i].seconds, targets[i].wc_count);
+		if (targets[i].status != PASS)
+			failed++;
+	}
+	printf("%d targets on %d buses, %d passed, %d failed, %.3f s\n",
+	       n, nbuses, n - failed, failed, now() - start);
+
+out:
+	free(buses);
+	for (i = 0; i < n; i++)
+		free(targets[i].dev);
+	free(targets);
+	return failed;
+}
@@ -0,0 +1,40 @@
+/*
+    gang.h - Programming many EEPROMs in parallel
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#ifndef _GANG_H_
+#define _GANG_H_
+
+#include <linux/types.h>
+#include "24cXX.h"
+
+struct gang_options {
+	const __u8 *data;	/* Image to write */
+	int len;
+	int mem_addr;		/* Where to write it */
+	int type;		/* Address mode, if part is NULL */
+	const struct eeprom_part *part;
+	int detect;		/* Detect the part of each target */
+	int page_size;		/* Overrides, 0 for the default */
+	unsigned write_timeout_us;
+};
+
+/* Write the image to every target listed in file path, one per line as
+   "device address", and verify it. The targets of different devices are
+   programmed in parallel, one thread per device. A report is printed to
+   the standard output. Returns the number of failed targets, or -1 if
+   the list can't be read. */
+extern int gang_program(const char *path, const struct gang_options *opt);
+
+#endif /* _GANG_H_ */
@@ -0,0 +1,36 @@
+/*
+    hash.h - Checksums of EEPROM contents
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <linux/types.h>
+
+/* CRC-32 as used by zlib, cksum -a crc32b and Ethernet. Start with 0,
+   feed the result back for each block of data. */
+extern __u32 crc32_update(__u32 crc, const __u8 *buf, size_t len);
+
+struct sha256 {
+	__u32 h[8];
+	__u64 len;		/* Bytes hashed so far */
+	__u8 block[64];
+};
+
+extern void sha256_init(struct sha256 *s);
+extern void sha256_update(struct sha256 *s, const __u8 *buf, size_t len);
+extern void sha256_final(struct sha256 *s, __u8 digest[32]);
+
+#endif /* _HASH_H_ */
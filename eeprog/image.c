@@ -0,0 +1,373 @@
+/*
+    image.c - EEPROM image files for eeprog
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+
+/* Read a whole pipe or terminal, at most max bytes */
+static int read_all(int fd, size_t max, __u8 **pbuf, size_t *plen)
+{
+	size_t size = 0, len = 0;
+	__u8 *buf = NULL, *p;
+	ssize_t n;
+
+	for (;;) {
+		if (len == size) {
+			size = size ? 2 * size : 65536;
+			p = realloc(buf, size);
+			if (!p) {
+				free(buf);
+				return -ENOMEM;
+			}
+			buf = p;
+		}
+		n = read(fd, buf + len, size - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			free(buf);
+			return -errno;
+		}
+		if (n == 0)
+			break;
+		len += n;
+		if (len > max) {
+			free(buf);
+			return -EFBIG;
+		}
+	}
+
+	*pbuf = buf;
+	*plen = len;
+	return 0;
+}
+
+static int hex_byte(const char *s)
+{
+	int i, c, v = 0;
+
+	for (i = 0; i < 2; i++) {
+		c = s[i];
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if (c >= 'a' && c <= 'f')
+			c -= 'a' - 10;
+		else if (c >= 'A' && c <= 'F')
+			c -= 'A' - 10;
+		else
+			return -1;
+		v = (v << 4) | c;
+	}
+	return v;
+}
+
+/* Decode Intel HEX text into a max-byte buffer */
+static int parse_ihex(const char *text, size_t tlen, int max,
+		      struct image *img)
+{
+	const char *p = text, *end = text + tlen, *eol;
+	unsigned int base = 0, addr;
+	int lo = max, hi = 0, i, n, type, sum, v;
+	__u8 rec[256 + 5], *buf;
+
+	buf = malloc(max ? max : 1);
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0xff, max);
+
+	for (; p < end; p = eol + 1) {
+		eol = memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+		if (eol > p && eol[-1] == '\r')
+			eol--;
+		if (eol == p)
+			goto next;	/* Blank line */
+		if (*p != ':' || (eol - p - 1) % 2 || eol - p < 11)
+			goto invalid;
+
+		/* Count, address, type, data and checksum */
+		n = (eol - p - 1) / 2;
+		if (n > (int)sizeof(rec))
+			goto invalid;
+		for (i = 0, sum = 0; i < n; i++) {
+			v = hex_byte(p + 1 + 2 * i);
+			if (v < 0)
+				goto invalid;
+			rec[i] = v;
+			sum += v;
+		}
+		if (rec[0] != n - 5 || (sum & 0xff))
+			goto invalid;
+		addr = (rec[1] << 8) | rec[2];
+		type = rec[3];
+
+		switch (type) {
+		case 0x00:	/* Data */
+			/* base + addr can't wrap, but addr + rec[0] can */
+			addr += base;
+			if (addr >= (unsigned int)max ||
+			    rec[0] > (unsigned int)max - addr)
+				goto too_big;
+			memcpy(buf + addr, rec + 4, rec[0]);
+			if (rec[0] && (int)addr < lo)
+				lo = addr;
+			if ((int)addr + rec[0] > hi)
+				hi = addr + rec[0];
+			break;
+		case 0x01:	/* End of file */
+			goto done;
+		case 0x02:	/* Extended segment address */
+			if (rec[0] != 2)
+				goto invalid;
+			base = ((rec[4] << 8) | rec[5]) << 4;
+			break;
+		case 0x04:	/* Extended linear address */
+			if (rec[0] != 2)
+				goto invalid;
+			base = ((rec[4] << 8) | rec[5]) << 16;
+			if (base && max <= 0x10000)
+				goto too_big;
+			break;
+		case 0x03:	/* Start segment address */
+		case 0x05:	/* Start linear address */
+			break;
+		default:
+			goto invalid;
+		}
+	next:
+		if (eol < end && *eol == '\r')
+			eol++;
+	}
+
+done:
+	if (hi == 0)
+		lo = 0;
+	img->alloc = buf;
+	img->data = buf + lo;
+	img->start = lo;
+	img->len = hi - lo;
+	return 0;
+
+invalid:
+	free(buf);
+	return -EINVAL;
+
+too_big:
+	free(buf);
+	return -EFBIG;
+}
+
+int image_load(const char *path, int format, int max, struct image *img)
+{
+	struct stat st;
+	__u8 *buf = NULL;
+	size_t len = 0;
+	void *map;
+	int fd, ret;
+
+	memset(img, 0, sizeof(*img));
+
+	if (!path || !strcmp(path, "-")) {
+		fd = 0;
+	} else {
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return -errno;
+	}
+
+	/* Map regular files, read pipes and terminals at once */
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		if (format == IMAGE_FORMAT_RAW && st.st_size > max) {
+			ret = -EFBIG;
+			goto out;
+		}
+		len = st.st_size;
+		map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			ret = -errno;
+			goto out;
+		}
+		img->map = map;
+		img->map_len = len;
+	} else {
+		ret = read_all(fd, format == IMAGE_FORMAT_RAW ? (size_t)max :
+			       (size_t)-1, &buf, &len);
+		if (ret)
+			goto out;
+		map = buf;
+	}
+
+	if (format == IMAGE_FORMAT_IHEX) {
+		ret = parse_ihex(map, len, max, img);
+		/* The text isn't needed any longer */
+		if (img->map)
+			munmap(img->map, img->map_len);
+		img->map = NULL;
+		free(buf);
+	} else {
+		img->data = map;
+		img->len = len;
+		img->alloc = buf;
+		ret = 0;
+	}
+
+out:
+	if (fd != 0)
+		close(fd);
+	return ret;
+}
+
+void image_skip(struct image *img, int skip)
+{
+	/* Intel HEX records may start beyond it */
+	if (skip <= img->start) {
+		img->start -= skip;
+		return;
+	}
+	skip -= img->start;
+	img->start = 0;
+	if (skip > img->len)
+		skip = img->len;
+	img->data += skip;
+	img->len -= skip;
+}
+
+void image_free(struct image *img)
+{
+	if (img->map)
+		munmap(img->map, img->map_len);
+	free(img->alloc);
+	memset(img, 0, sizeof(*img));
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -errno;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Intel HEX records of 16 bytes, with extended linear address records
+   for addresses above 64 KiB */
+static size_t format_ihex(char *out, int addr, const __u8 *buf, int len)
+{
+	char *p = out;
+	int i, j, n, a, sum;
+
+	for (i = 0; i < len; i += n) {
+		a = addr + i;
+		if ((i == 0 && a >> 16) || (i && !(a & 0xffff))) {
+			sum = 2 + 4 + (a >> 24) + (a >> 16);
+			p += sprintf(p, ":02000004%04X%02X\n", (a >> 16) & 0xffff,
+				     -sum & 0xff);
+		}
+		/* Records don't cross 64 KiB boundaries */
+		n = len - i < 16 ? len - i : 16;
+		if ((a & 0xffff) + n > 0x10000)
+			n = 0x10000 - (a & 0xffff);
+		sum = n + (a >> 8) + a;
+		p += sprintf(p, ":%02X%04X00", n, a & 0xffff);
+		for (j = 0; j < n; j++) {
+			p += sprintf(p, "%02X", buf[i + j]);
+			sum += buf[i + j];
+		}
+		p += sprintf(p, "%02X\n", -sum & 0xff);
+	}
+	p += sprintf(p, ":00000001FF\n");
+
+	return p - out;
+}
+
+/* The traditional eeprog hexadecimal dump */
+static size_t format_dump(char *out, int addr, const __u8 *buf, int len)
+{
+	char *p = out;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if ((i % 16) == 0)
+			p += sprintf(p, "\n %.4x|  ", addr + i);
+		else if ((i % 8) == 0)
+			p += sprintf(p, "  ");
+		p += sprintf(p, "%.2x ", buf[i]);
+	}
+	p += sprintf(p, "\n\n");
+
+	return p - out;
+}
+
+int image_save(const char *path, int format, int addr, const __u8 *buf,
+	       int len)
+{
+	char *text = NULL;
+	size_t tlen;
+	int fd, ret;
+
+	switch (format) {
+	case IMAGE_FORMAT_IHEX:
+		/* At most 44 characters per record, one more data record
+		   and one extended address record per 64 KiB boundary */
+		text = malloc((len / 16 + 2 * (len / 65536) + 4) * 44);
+		if (!text)
+			return -ENOMEM;
+		tlen = format_ihex(text, addr, buf, len);
+		break;
+	case IMAGE_FORMAT_DUMP:
+		/* 59 characters per line of 16 bytes */
+		text = malloc(len * 4 + 16);
+		if (!text)
+			return -ENOMEM;
+		tlen = format_dump(text, addr, buf, len);
+		break;
+	default:
+		tlen = len;
+		break;
+	}
+
+	if (!path || !strcmp(path, "-")) {
+		fd = 1;
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			ret = -errno;
+			goto out;
+		}
+	}
+
+	ret = write_all(fd, text ? (const void *)text : buf, tlen);
+	if (fd != 1 && close(fd) < 0 && !ret)
+		ret = -errno;
+out:
+	free(text);
+	return ret;
+}
@@ -0,0 +1,57 @@
+/*
+    image.h - EEPROM image files for eeprog
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include <stddef.h>
+#include <linux/types.h>
+
+#define IMAGE_FORMAT_RAW	0	/* Binary */
+#define IMAGE_FORMAT_IHEX	1	/* Intel HEX */
+#define IMAGE_FORMAT_DUMP	2	/* Hexadecimal dump, output only */
+
+struct image {
+	const __u8 *data;	/* Image contents */
+	int len;		/* Number of bytes */
+	int start;		/* Offset of data in the image, non-zero if
+				   the Intel HEX records don't start at 0 */
+
+	/* Private */
+	void *map;
+	size_t map_len;
+	void *alloc;
+};
+
+/* Load an image from file path, or the standard input if path is NULL or
+   "-". Regular files are mapped, other files are read at once. Images
+   larger than max bytes are refused. Intel HEX gaps are filled with
+   0xff. Returns 0 or a negative errno, -EINVAL for invalid Intel HEX
+   data, -EFBIG for images too large. */
+extern int image_load(const char *path, int format, int max,
+		      struct image *img);
+extern void image_free(struct image *img);
+
+/* Drop the first skip bytes of the image, the rest moves down by skip
+   bytes. Load the image with skip more bytes allowed. */
+extern void image_skip(struct image *img, int skip);
+
+/* Save len bytes of buf, read from address addr, to file path, or the
+   standard output if path is NULL or "-", with a single write. Returns 0
+   or a negative errno. */
+extern int image_save(const char *path, int format, int addr,
+		      const __u8 *buf, int len);
+
+#endif /* _IMAGE_H_ */
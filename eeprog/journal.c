@@ -0,0 +1,111 @@
+/*
+    journal.c - Progress journal for resumable EEPROM writes
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "journal.h"
+
+/* Mark the ranges listed after the header. A line cut short by an
+   interruption, and what follows it, are dropped. */
+static int journal_load(struct journal *j, const char *header)
+{
+	char line[512];
+	unsigned off, len;
+	long pos;
+	char end;
+
+	if (!fgets(line, sizeof(line), j->f))
+		return -ESTALE;
+	line[strcspn(line, "\n")] = '\0';
+	if (strcmp(line, header))
+		return -ESTALE;
+
+	for (;;) {
+		pos = ftell(j->f);
+		if (!fgets(line, sizeof(line), j->f) ||
+		    sscanf(line, "%x %u%c", &off, &len, &end) != 3 ||
+		    end != '\n')
+			break;
+		if (off > (unsigned)j->len || len > j->len - off)
+			return -ESTALE;
+		memset(j->done + off, 1, len);
+	}
+
+	if (pos < 0 || fseek(j->f, pos, SEEK_SET) < 0 ||
+	    ftruncate(fileno(j->f), pos) < 0)
+		return -errno;
+	return 0;
+}
+
+int journal_open(struct journal *j, const char *path, const char *header,
+		 int len, int resume)
+{
+	int ret;
+
+	memset(j, 0, sizeof(*j));
+	j->len = len;
+	j->done = calloc(1, len + 1);
+	j->path = strdup(path);
+	if (!j->done || !j->path) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	if (resume && (j->f = fopen(path, "r+"))) {
+		ret = journal_load(j, header);
+		if (ret)
+			goto fail;
+		return 0;
+	}
+
+	j->f = fopen(path, "w");
+	if (!j->f) {
+		ret = -errno;
+		goto fail;
+	}
+	if (fprintf(j->f, "%s\n", header) < 0 || fflush(j->f) ||
+	    fsync(fileno(j->f))) {
+		ret = -errno;
+		goto fail;
+	}
+	return 0;
+
+fail:
+	if (j->f)
+		fclose(j->f);
+	free(j->done);
+	free(j->path);
+	return ret;
+}
+
+int journal_add(struct journal *j, int off, int len)
+{
+	memset(j->done + off, 1, len);
+	if (fprintf(j->f, "0x%x %d\n", off, len) < 0 || fflush(j->f) ||
+	    fsync(fileno(j->f)))
+		return -errno;
+	return 0;
+}
+
+void journal_close(struct journal *j, int complete)
+{
+	fclose(j->f);
+	if (complete)
+		unlink(j->path);
+	free(j->done);
+	free(j->path);
+}
@@ -0,0 +1,51 @@
+/*
+    journal.h - Progress journal for resumable EEPROM writes
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <stdio.h>
+#include <linux/types.h>
+
+/*
+ * A journal is a text file starting with a header line identifying the
+ * write (image hash, device, addresses, page size), followed by one line per range
+ * of the image written and verified, as offset and length. Lines are
+ * synced to disk as they are added, so the journal survives interrupted
+ * writes.
+ */
+
+struct journal {
+	FILE *f;
+	char *path;
+	__u8 *done;	/* Per image byte, set if written and verified */
+	int len;
+};
+
+/* Open the journal at path for a write of len bytes identified by header
+   (a single line, without newline). If resume is set and the journal
+   exists, the ranges it lists are marked done, and it is extended;
+   otherwise it is created anew. Returns 0, -ESTALE if the journal is for
+   another write, or another negative errno. */
+extern int journal_open(struct journal *j, const char *path,
+			const char *header, int len, int resume);
+
+/* Record that len bytes from off were written and verified */
+extern int journal_add(struct journal *j, int off, int len);
+
+/* Close the journal, and delete it if the write is complete */
+extern void journal_close(struct journal *j, int complete);
+
+#endif /* _JOURNAL_H_ */
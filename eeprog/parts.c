@@ -0,0 +1,218 @@
+/*
+    parts.c - 24Cxx EEPROM part database and detection
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <i2c/smbus.h>
+#include "24cXX.h"
+
+#define A8	EEPROM_TYPE_8BIT_ADDR
+#define A16	EEPROM_TYPE_16BIT_ADDR
+
+/*
+ * The generic 24Cxx entries come first, detection picks them by size.
+ * Their page size is the smallest found among the parts of that size.
+ */
+const struct eeprom_part eeprom_parts[] = {
+	{ "24c01",	A8,	128,	8,	0 },
+	{ "24c02",	A8,	256,	8,	0 },
+	{ "24c04",	A8,	512,	16,	0 },
+	{ "24c08",	A8,	1024,	16,	0 },
+	{ "24c16",	A8,	2048,	16,	0 },
+	{ "24c32",	A16,	4096,	32,	0 },
+	{ "24c64",	A16,	8192,	32,	0 },
+	{ "24c128",	A16,	16384,	64,	0 },
+	{ "24c256",	A16,	32768,	64,	0 },
+	{ "24c512",	A16,	65536,	128,	0 },
+	{ "24c1024",	A16,	131072,	128,	0 },
+	{ "24m02",	A16,	262144,	256,	0 },
+	{ "m24c01",	A8,	128,	16,	0 },
+	{ "m24c02",	A8,	256,	16,	0 },
+	{ "m24c04",	A8,	512,	16,	0 },
+	{ "m24c08",	A8,	1024,	16,	0 },
+	{ "m24c16",	A8,	2048,	16,	0 },
+	{ "m24c32",	A16,	4096,	32,	0 },
+	{ "m24c64",	A16,	8192,	32,	0 },
+	{ "m24128",	A16,	16384,	64,	0 },
+	{ "m24256",	A16,	32768,	64,	0 },
+	{ "m24512",	A16,	65536,	128,	0 },
+	{ "m24m01",	A16,	131072,	256,	0 },
+	{ "m24m02",	A16,	262144,	256,	0 },
+	{ "at24cs01",	A8,	128,	8,	1 },
+	{ "at24cs02",	A8,	256,	8,	1 },
+	{ "at24cs32",	A16,	4096,	32,	1 },
+	{ "at24cs64",	A16,	8192,	32,	1 },
+	{ NULL,		0,	0,	0,	0 }
+};
+
+const struct eeprom_part *eeprom_find_part(const char *name)
+{
+	const struct eeprom_part *p;
+
+	for(p = eeprom_parts; p->name; p++)
+		if(!strcasecmp(p->name, name))
+			return p;
+	return NULL;
+}
+
+void eeprom_set_part(struct eeprom *e, const struct eeprom_part *part)
+{
+	e->part = part;
+	e->type = part->type;
+	e->size = part->size;
+	e->page_size = part->page_size;
+}
+
+// number of i2c addresses used by [part]
+static unsigned part_chips(const struct eeprom_part *part)
+{
+	unsigned block = part->type == A16 ? 0x10000 : 0x100;
+
+	return part->size > block ? part->size / block : 1;
+}
+
+static int chip_responds(struct eeprom *e, int addr)
+{
+	if(ioctl(e->fd, I2C_SLAVE, addr) < 0)
+		return 0;
+	// a current address read, which changes nothing
+	return i2c_smbus_read_byte(e->fd) >= 0;
+}
+
+int eeprom_detect(struct eeprom *e)
+{
+	const struct eeprom_part *p, *q;
+	struct eeprom t;
+	__u8 *buf, chunk[16];
+	unsigned size, have = 0, i, n;
+	int r = -1;
+
+	buf = malloc(2 * EEPROM_MAX_SIZE);
+	if(!buf)
+		return -1;
+	if(!chip_responds(e, e->addr)) {
+		fprintf(stderr, "Error: no eeprom at 0x%02x\n", e->addr);
+		goto out;
+	}
+
+	// move to address 0 of 8bit parts; 16bit parts take the single
+	// address byte as the high byte, without writing anything
+	if(i2c_smbus_write_byte(e->fd, 0) < 0) {
+		fprintf(stderr, "Error eeprom_detect: %s\n", strerror(errno));
+		goto out;
+	}
+
+	// sequential reads roll over at the end of the memory, and the
+	// capacity is a power of 2
+	for(size = 128; size <= EEPROM_MAX_SIZE; size *= 2) {
+		if(eeprom_read_current_block(e, buf + have, 2 * size - have))
+			goto out;
+		have = 2 * size;
+		if(!memcmp(buf, buf + size, size))
+			break;
+	}
+	if(size > EEPROM_MAX_SIZE) {
+		fprintf(stderr, "Error: memory doesn't wrap around within "
+			"%u bytes, not a 24Cxx eeprom\n", EEPROM_MAX_SIZE);
+		goto out;
+	}
+	for(i = 1; i < size && buf[i] == buf[0]; i++)
+		;
+	if(i == size) {
+		fprintf(stderr, "Error: uniform contents, the capacity can't "
+			"be detected\n");
+		goto out;
+	}
+	for(p = eeprom_parts; p->name && p->size != size; p++)
+		;
+	if(!p->name) {
+		fprintf(stderr, "Error: no part of %u bytes\n", size);
+		goto out;
+	}
+
+	// large parts use consecutive i2c addresses, which must all respond,
+	// and for 8bit parts show the memory read sequentially from the first
+	n = part_chips(p);
+	if(e->addr % n) {
+		fprintf(stderr, "Error: %s found, but it should be used at "
+			"address 0x%02x\n", p->name, e->addr - e->addr % n);
+		goto out;
+	}
+	t = *e;
+	eeprom_set_part(&t, p);
+	for(i = 1; i < n; i++) {
+		if(!chip_responds(&t, e->addr + i)) {
+			fprintf(stderr, "Error: %u bytes wrap around, but "
+				"0x%02x doesn't respond\n", size, e->addr + i);
+			goto out;
+		}
+		if(p->type == A8 &&
+		   (eeprom_read_block(&t, i * 0x100, chunk, sizeof(chunk)) ||
+		    memcmp(chunk, buf + i * 0x100, sizeof(chunk)))) {
+			fprintf(stderr, "Error: 0x%02x isn't part of the "
+				"eeprom at 0x%02x\n", e->addr + i, e->addr);
+			goto out;
+		}
+	}
+
+	// AT24CS parts answer at address + 8 for their serial number
+	if((e->addr & ~7) == 0x50 && chip_responds(&t, e->addr + 8)) {
+		for(q = eeprom_parts; q->name; q++)
+			if(q->serial && q->size == size)
+				p = q;
+	}
+
+	eeprom_set_part(e, p);
+	r = 0;
+out:
+	free(buf);
+	return r;
+}
+
+int eeprom_read_serial(struct eeprom *e, __u8 serial[16])
+{
+	struct i2c_eeprom_geometry geo;
+	struct i2c_eeprom *s;
+	unsigned mem_addr;
+	int r;
+
+	// a read-only area at address 0x80 or 0x800, depending on the
+	// address mode
+	mem_addr = e->type == A16 ? 0x800 : 0x80;
+	geo.size = mem_addr + 16;
+	geo.page_size = 1;
+	geo.addr_len = e->type == A16 ? 2 : 1;
+	geo.write_timeout_us = 0;
+	s = i2c_eeprom_open(e->fd, e->addr + 8, &geo);
+	if(!s) {
+		fprintf(stderr, "Error eeprom_read_serial: %s\n",
+			strerror(errno));
+		return -1;
+	}
+	r = i2c_eeprom_read(s, mem_addr, serial, 16);
+	i2c_eeprom_close(s);
+	if(r < 0) {
+		fprintf(stderr, "Error eeprom_read_serial: %s\n",
+			strerror(-r));
+		return -1;
+	}
+	return 0;
+}
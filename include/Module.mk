@@ -9,7 +9,8 @@
 
 INCLUDE_DIR	:= include
 
-INCLUDE_TARGETS	:= i2c/smbus.h
+INCLUDE_TARGETS	:= i2c/smbus.h i2c/remote.h i2c/sched.h i2c/lock.h \
+		   i2c/eeprom.h
 
 #
 # Commands
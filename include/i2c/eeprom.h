@@ -0,0 +1,106 @@
+/*
+    eeprom.h - Access to 24Cxx I2C EEPROMs
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#ifndef LIB_I2C_EEPROM_H
+#define LIB_I2C_EEPROM_H
+
+#include <stddef.h>
+
+/*
+ * Reads are done with as few transactions as the adapter allows: a
+ * memory address write and a sequential read combined in one I2C_RDWR
+ * transfer on I2C adapters, SMBus I2C block reads or byte reads
+ * otherwise. Writes are split in page writes, or SMBus block or byte
+ * writes, and the end of each write cycle is found by polling the chip
+ * until it acknowledges its address again. The last write cycle of
+ * i2c_eeprom_write() is only waited for by the next operation, so that
+ * the caller can do something else meanwhile.
+ *
+ * The file is a local or remote i2c-dev file. The address selected on it
+ * with I2C_SLAVE is not preserved, other users may share it between
+ * calls. A handle must not be used by several threads at once.
+ */
+
+struct i2c_eeprom;
+
+#define I2C_EEPROM_MAX_PAGE_SIZE	256
+/* Default limit for the write cycle time (tWR, 5 or 10 ms on most parts) */
+#define I2C_EEPROM_WRITE_TIMEOUT_US	25000
+
+/* Parts larger than 256 bytes with 1 address byte, or 64 KiB with 2
+   address bytes, answer at up to 8 consecutive chip addresses, holding
+   256 bytes or 64 KiB each */
+struct i2c_eeprom_geometry {
+	unsigned int size;		/* Capacity in bytes */
+	unsigned int page_size;		/* 1 to I2C_EEPROM_MAX_PAGE_SIZE */
+	unsigned int addr_len;		/* Memory address bytes, 1 or 2 */
+	unsigned int write_timeout_us;	/* 0 for I2C_EEPROM_WRITE_TIMEOUT_US */
+};
+
+/* Write cycle times, in microseconds, from the end of the write to the
+   first acknowledged poll. min_us is meaningless until write_cycles is
+   non-zero. */
+struct i2c_eeprom_stats {
+	unsigned long write_cycles;
+	unsigned long min_us;
+	unsigned long max_us;
+	unsigned long long total_us;
+};
+
+/* Open the EEPROM at address on the bus opened as file. Returns NULL with
+   errno set on error: EINVAL for a bad geometry, EOPNOTSUPP if the
+   adapter lacks the transactions needed, EBUSY if a driver uses the
+   address. Doesn't access the EEPROM. */
+extern struct i2c_eeprom *i2c_eeprom_open(int file, int address,
+				const struct i2c_eeprom_geometry *geo);
+
+/* Wait for the last write cycle and free the handle. Doesn't close the
+   file. */
+extern void i2c_eeprom_close(struct i2c_eeprom *ee);
+
+/* Change the geometry, for instance once the part is known. Returns 0
+   or a negative errno like i2c_eeprom_open(). */
+extern int i2c_eeprom_set_geometry(struct i2c_eeprom *ee,
+				   const struct i2c_eeprom_geometry *geo);
+
+/* Read len bytes from offset into buf. Returns 0 or a negative errno:
+   -EINVAL if the range is out of the EEPROM. */
+extern int i2c_eeprom_read(struct i2c_eeprom *ee, unsigned int offset,
+			   void *buf, size_t len);
+
+/* Read len bytes from the current address of the chip at the address of
+   the handle, which is where the last access left it, without writing
+   anything. The end of a write cycle is polled with a 1-byte read, which
+   a quick write can't safely replace, so after a write to that chip, the
+   current address is one byte past where the write left it. Returns 0 or
+   a negative errno. */
+extern int i2c_eeprom_read_current(struct i2c_eeprom *ee, void *buf,
+				   size_t len);
+
+/* Write len bytes from buf at offset. Returns 0 or a negative errno:
+   -EINVAL if the range is out of the EEPROM, -ETIMEDOUT if a write cycle
+   doesn't complete within the write timeout. */
+extern int i2c_eeprom_write(struct i2c_eeprom *ee, unsigned int offset,
+			    const void *buf, size_t len);
+
+/* Wait for the last write cycle to complete. Returns 0 or a negative
+   errno. */
+extern int i2c_eeprom_sync(struct i2c_eeprom *ee);
+
+extern void i2c_eeprom_get_stats(struct i2c_eeprom *ee,
+				 struct i2c_eeprom_stats *stats);
+
+#endif /* LIB_I2C_EEPROM_H */
@@ -0,0 +1,40 @@
+/*
+    lock.h - Advisory locking of I2C chips across processes
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#ifndef LIB_I2C_LOCK_H
+#define LIB_I2C_LOCK_H
+
+/* Default directory of the lock files, can be overridden with the
+   I2C_LOCK_DIR environment variable */
+#define I2C_LOCK_DIR		"/run/lock"
+
+/*
+ * Lock the chip at address on bus i2cbus, so that cooperating processes
+ * don't interleave their transactions with a multi-transaction sequence
+ * (register bank switching, read-modify-write...). Other chips on the
+ * same bus are not affected. The lock is a flock(2) on the file
+ * i2c-<i2cbus>-<address>.lock, so it is released if the process dies.
+ * Waits up to timeout_ms milliseconds, forever if negative. Returns the
+ * lock, or a negative errno: -ETIMEDOUT if the chip is still locked by
+ * someone else after the timeout, -ELOOP if the lock file is a symbolic
+ * link.
+ */
+extern int i2c_lock_chip(int i2cbus, int address, int timeout_ms);
+
+/* Release a lock returned by i2c_lock_chip(), does nothing if negative */
+extern void i2c_unlock_chip(int lock);
+
+#endif /* LIB_I2C_LOCK_H */
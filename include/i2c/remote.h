@@ -0,0 +1,183 @@
+/*
+    remote.h - Access to I2C buses through the i2cd daemon
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#ifndef LIB_I2C_REMOTE_H
+#define LIB_I2C_REMOTE_H
+
+#include <linux/types.h>
+#include <linux/i2c.h>
+
+/* Default path of the i2cd socket */
+#define I2CD_SOCKET		"/run/i2cd.sock"
+
+/* Connect to the i2cd daemon listening on socket path (or I2CD_SOCKET if
+   NULL) and open bus i2cbus through it. Returns a file descriptor which
+   can be used with i2c_ioctl(), i2c_flock() and all the i2c_smbus_*
+   functions as if it was /dev/i2c-<i2cbus>, or -1 with errno set. */
+extern int i2c_remote_open(const char *socket, int i2cbus);
+
+/* Like ioctl(), but forwards the i2c-dev requests (I2C_SLAVE,
+   I2C_SLAVE_FORCE, I2C_FUNCS, I2C_PEC, I2C_SMBUS and I2C_RDWR) to i2cd
+   if file was returned by i2c_remote_open(). */
+extern int i2c_ioctl(int file, unsigned long request, ...);
+
+/* Like flock(). For a remote file, i2cd stops serving the other clients
+   of the same bus while the lock is held. */
+extern int i2c_flock(int file, int operation);
+
+/*
+ * Ring mode: transactions are passed to i2cd through a pair of
+ * single-producer/single-consumer rings in shared memory, and eventfd
+ * doorbells, instead of one socket round trip each. Many transactions
+ * can be queued before ringing the doorbell with i2c_ring_submit().
+ * Each queued transaction gets a payload slot, where the read data can
+ * be found once it has completed, without copy. Transactions are
+ * executed in order. A struct i2c_ring must only be used by one thread
+ * at a time.
+ */
+
+struct i2c_ring;
+
+/* Flags for i2c_ring_queue_smbus() */
+#define I2C_RING_FORCE		0x0001	/* Like I2C_SLAVE_FORCE */
+#define I2C_RING_PEC		0x0002	/* Like I2C_PEC */
+
+struct i2c_ring_cqe {
+	__u64 user_data;	/* As passed when queuing */
+	__s32 ret;		/* Like the ioctl, or a negative errno */
+	__u32 slot;		/* Payload slot holding the read data */
+};
+
+/* Open bus i2cbus through i2cd in ring mode, with room for entries
+   (a power of 2) transactions in flight, each with slot_size bytes of
+   payload. Returns NULL with errno set on error. */
+extern struct i2c_ring *i2c_ring_open(const char *socket, int i2cbus,
+				      unsigned int entries,
+				      unsigned int slot_size);
+extern void i2c_ring_close(struct i2c_ring *ring);
+
+/* The underlying i2cd connection, for use with i2c_ioctl(). Requests
+   made on it are not ordered with respect to the ring transactions. */
+extern int i2c_ring_file(struct i2c_ring *ring);
+
+/* Queue a transaction. Returns its payload slot, -EAGAIN if entries
+   transactions are already in flight, or -EINVAL if it doesn't fit in
+   a slot. Nothing is sent until i2c_ring_submit() is called. */
+extern int i2c_ring_queue_smbus(struct i2c_ring *ring, __u16 addr, int flags,
+				char read_write, __u8 command, int size,
+				const union i2c_smbus_data *data,
+				__u64 user_data);
+extern int i2c_ring_queue_rdwr(struct i2c_ring *ring,
+			       const struct i2c_msg *msgs, unsigned int nmsgs,
+			       __u64 user_data);
+
+/* Ring the doorbell for all the queued transactions. Returns 0 or a
+   negative errno. */
+extern int i2c_ring_submit(struct i2c_ring *ring);
+
+/* Get the next completion, in submission order. Returns 1 on success,
+   0 if there is none and either wait is not set or nothing was submitted,
+   or a negative errno. The slot data stays valid until the next
+   transaction is queued. */
+extern int i2c_ring_reap(struct i2c_ring *ring, struct i2c_ring_cqe *cqe,
+			 int wait);
+
+/* Payload slot, holding a struct i2cd_smbus for SMBus transactions, or
+   the read messages data, concatenated, for I2C transfers */
+extern void *i2c_ring_slot(struct i2c_ring *ring, unsigned int slot);
+
+/*
+ * Protocol between the library and i2cd, over a Unix stream socket.
+ * Every request is a struct i2cd_request followed by len bytes of
+ * payload, and is answered by a struct i2cd_reply followed by len bytes
+ * of payload. Requests are served in order. A negative ret is an errno
+ * value.
+ */
+
+enum i2cd_op {
+	I2CD_OPEN = 1,		/* arg: bus number */
+	I2CD_FUNCS,		/* reply: __u64 functionality */
+	I2CD_SLAVE,		/* arg: address */
+	I2CD_SLAVE_FORCE,	/* arg: address */
+	I2CD_PEC,		/* arg: 0 or 1 */
+	I2CD_SMBUS,		/* payload and reply: struct i2cd_smbus */
+	I2CD_RDWR,		/* arg: nmsgs, payload: nmsgs struct i2cd_msg
+				   then write data, reply: read data */
+	I2CD_LOCK,		/* arg: LOCK_EX or LOCK_UN */
+	I2CD_RING,		/* arg: entries, payload: __u32 slot size,
+				   with the memfd and the submission and
+				   completion eventfds attached */
+};
+
+struct i2cd_request {
+	__u32 op;
+	__u32 arg;
+	__u32 len;
+};
+
+struct i2cd_reply {
+	__s32 ret;
+	__u32 len;
+};
+
+struct i2cd_smbus {
+	__u8 read_write;
+	__u8 command;
+	__u16 size;
+	union i2c_smbus_data data;
+};
+
+struct i2cd_msg {
+	__u16 addr;
+	__u16 flags;
+	__u16 len;
+	__u16 reserved;
+};
+
+/*
+ * Ring mode shared memory layout: submission ring index, completion
+ * ring index, submission entries, completion entries, then one payload
+ * slot per entry. The producer of a ring only writes its tail, the
+ * consumer only its head.
+ */
+
+struct i2c_ring_index {
+	__u32 head;
+	__u32 tail;
+	__u32 pad[14];		/* Keep each index in its own cache line */
+};
+
+struct i2c_ring_sqe {
+	__u64 user_data;
+	__u16 op;		/* I2CD_SMBUS or I2CD_RDWR */
+	__u16 addr;		/* Chip address, SMBus only */
+	__u16 flags;		/* I2C_RING_*, SMBus only */
+	__u16 slot;
+	__u32 len;		/* Bytes of payload in the slot */
+	__u32 nmsgs;		/* I2C only */
+};
+
+#define I2C_RING_SIZE(entries, slot_size) \
+	(2 * sizeof(struct i2c_ring_index) + \
+	 (entries) * (sizeof(struct i2c_ring_sqe) + \
+		      sizeof(struct i2c_ring_cqe) + (slot_size)))
+
+#define I2C_RING_MAX_ENTRIES	4096
+
+/* Largest payload of a request or reply */
+#define I2CD_MAX_PAYLOAD	(42 * (sizeof(struct i2cd_msg) + 8192))
+
+#endif /* LIB_I2C_REMOTE_H */
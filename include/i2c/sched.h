@@ -0,0 +1,122 @@
+/*
+    sched.h - Priority and deadline scheduling of I2C transactions
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#ifndef LIB_I2C_SCHED_H
+#define LIB_I2C_SCHED_H
+
+#include <linux/types.h>
+#include <linux/i2c.h>
+
+/*
+ * A scheduler queues the transactions of several users of the same bus,
+ * and executes them one at a time: higher priority classes first, and
+ * within a class, earliest deadline first, then in submission order.
+ * Large block reads are executed in chunks, and the scheduler picks the
+ * next transaction again between chunks, so that an urgent transaction
+ * doesn't have to wait for a long read to complete. All the functions
+ * are thread-safe. Deadlines are only used for ordering and reporting,
+ * late transactions are still executed.
+ */
+
+struct i2c_sched;
+
+/* Priority classes, most urgent first */
+enum i2c_sched_class {
+	I2C_SCHED_URGENT,
+	I2C_SCHED_NORMAL,
+	I2C_SCHED_BULK,
+};
+#define I2C_SCHED_CLASSES	3
+
+enum i2c_sched_type {
+	I2C_SCHED_SMBUS,	/* Any SMBus transaction */
+	I2C_SCHED_BLOCK_READ,	/* len bytes from register command onwards,
+				   with I2C block reads, preemptible */
+};
+
+/* Flags */
+#define I2C_SCHED_FORCE		0x0001	/* Like I2C_SLAVE_FORCE */
+#define I2C_SCHED_PEC		0x0002	/* Like I2C_PEC */
+
+/* Requests must be zeroed before being filled in the first time */
+struct i2c_sched_req {
+	/* Set by the caller */
+	int type;
+	int sched_class;
+	unsigned int deadline_us;	/* From submission, 0 for none */
+	__u16 addr;
+	int flags;
+	char read_write;		/* SMBus only */
+	__u8 command;
+	int size;			/* SMBus only */
+	union i2c_smbus_data *data;	/* SMBus only */
+	__u8 *buf;			/* Block read only */
+	unsigned int len;		/* Block read only */
+	void (*complete)(struct i2c_sched_req *req);	/* Optional */
+	void *priv;
+
+	/* Set by the scheduler on completion */
+	int ret;		/* Like i2c_smbus_access(), or bytes read */
+	int missed;		/* Completed after the deadline */
+	__u64 late_ns;		/* By that much */
+
+	/* Private */
+	int state;
+	unsigned int done;
+	__u64 due_ns;
+	struct i2c_sched_req *next;
+};
+
+struct i2c_sched_stats {
+	unsigned long completed[I2C_SCHED_CLASSES];
+	unsigned long missed[I2C_SCHED_CLASSES];
+	__u64 max_late_ns[I2C_SCHED_CLASSES];
+};
+
+/* Create a scheduler for the bus opened as file (a local or remote
+   i2c-dev file). Block reads are split in chunks of at most chunk
+   bytes, 0 for I2C_SMBUS_BLOCK_MAX. Returns NULL with errno set on
+   error. */
+extern struct i2c_sched *i2c_sched_new(int file, unsigned int chunk);
+
+/* Stop the worker thread if any, and complete the pending transactions
+   with -ECANCELED. Doesn't close the file. */
+extern void i2c_sched_free(struct i2c_sched *sched);
+
+/* Start a worker thread executing the transactions as they come. Without
+   it, transactions are executed by i2c_sched_run() and
+   i2c_sched_wait(). Returns 0 or a negative errno. */
+extern int i2c_sched_start(struct i2c_sched *sched);
+
+/* Queue a transaction. The request must stay valid until completed.
+   Returns 0 or a negative errno. */
+extern int i2c_sched_submit(struct i2c_sched *sched,
+			    struct i2c_sched_req *req);
+
+/* Wait for a transaction to complete, returns its ret value. Use either
+   this or a completion callback: the scheduler doesn't touch the request
+   after calling complete, but the waiter may be woken up before. */
+extern int i2c_sched_wait(struct i2c_sched *sched, struct i2c_sched_req *req);
+
+/* Execute the next transaction, or chunk of it, for callers driving the
+   scheduler from their own loop. Returns 1 if something was executed, 0
+   if the queues are empty and wait is not set. */
+extern int i2c_sched_run(struct i2c_sched *sched, int wait);
+
+extern void i2c_sched_get_stats(struct i2c_sched *sched,
+				struct i2c_sched_stats *stats);
+
+#endif /* LIB_I2C_SCHED_H */
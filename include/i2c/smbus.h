@@ -38,6 +38,24 @@ extern __s32 i2c_smbus_read_word_data(int file, __u8 command);
 extern __s32 i2c_smbus_write_word_data(int file, __u8 command, __u16 value);
 extern __s32 i2c_smbus_process_call(int file, __u8 command, __u16 value);
 
+/* Read-modify-write of the bits set in mask. The caller must lock the
+   chip, see i2c_lock_chip(). Returns the previous register value. */
+extern __s32 i2c_smbus_update_byte_data(int file, __u8 command, __u8 mask,
+					__u8 value);
+extern __s32 i2c_smbus_update_word_data(int file, __u8 command, __u16 mask,
+					__u16 value);
+
+/* Poll until (value & mask) == match, with exponential backoff. Returns
+   the last value read, -ETIMEDOUT if the condition wasn't met after
+   timeout_ms milliseconds, or another negative errno on read error (-EIO
+   for a bus timeout). */
+extern __s32 i2c_smbus_poll_byte_data(int file, __u8 command, __u8 mask,
+				      __u8 match, unsigned int timeout_ms,
+				      unsigned int *polls);
+extern __s32 i2c_smbus_poll_word_data(int file, __u8 command, __u16 mask,
+				      __u16 match, unsigned int timeout_ms,
+				      unsigned int *polls);
+
 /* Returns the number of read bytes */
 extern __s32 i2c_smbus_read_block_data(int file, __u8 command, __u8 *values);
 extern __s32 i2c_smbus_write_block_data(int file, __u8 command, __u8 length,
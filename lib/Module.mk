@@ -16,9 +16,10 @@ LIB_CFLAGS	:= -Wstrict-prototypes -Wshadow -Wpointer-arith -Wcast-qual \
 # The main and minor version of the library
 # The library soname (major number) must be changed if and only if the
 # interface is changed in a backward incompatible way.  The interface is
-# defined by the public header files - in this case they are only smbus.h.
+# defined by the public header files - in this case smbus.h, remote.h,
+# sched.h, lock.h and eeprom.h.
 LIB_MAINVER	:= 0
-LIB_MINORVER	:= 1.0
+LIB_MINORVER	:= 2.0
 LIB_VER		:= $(LIB_MAINVER).$(LIB_MINORVER)
 
 # The shared and static library names
@@ -29,18 +30,19 @@ LIB_STLIBNAME	:= libi2c.a
 
 LIB_TARGETS	:= $(LIB_SHLIBNAME)
 LIB_LINKS	:= $(LIB_SHSONAME) $(LIB_SHBASENAME)
-LIB_OBJECTS	:= smbus.o
+LIB_OBJECTS	:= smbus.o remote.o sched.o lock.o eeprom.o
 ifeq ($(BUILD_STATIC_LIB),1)
 LIB_TARGETS	+= $(LIB_STLIBNAME)
-LIB_OBJECTS	+= smbus.ao
+LIB_OBJECTS	+= smbus.ao remote.ao sched.ao lock.ao eeprom.ao
 endif
 
 #
 # Libraries
 #
 
-$(LIB_DIR)/$(LIB_SHLIBNAME): $(LIB_DIR)/smbus.o
-	$(CC) -shared $(LDFLAGS) -Wl,--version-script=$(LIB_DIR)/libi2c.map -Wl,-soname,$(LIB_SHSONAME) -o $@ $^ -lc
+$(LIB_DIR)/$(LIB_SHLIBNAME): $(LIB_DIR)/smbus.o $(LIB_DIR)/remote.o $(LIB_DIR)/sched.o $(LIB_DIR)/lock.o \
+				 $(LIB_DIR)/eeprom.o
+	$(CC) -shared $(LDFLAGS) -Wl,--version-script=$(LIB_DIR)/libi2c.map -Wl,-soname,$(LIB_SHSONAME) -o $@ $^ -lpthread -lc
 
 $(LIB_DIR)/$(LIB_SHSONAME):
 	$(RM) $@
@@ -50,7 +52,8 @@ $(LIB_DIR)/$(LIB_SHBASENAME):
 	$(RM) $@
 	$(LN) $(LIB_SHLIBNAME) $@
 
-$(LIB_DIR)/$(LIB_STLIBNAME): $(LIB_DIR)/smbus.ao
+$(LIB_DIR)/$(LIB_STLIBNAME): $(LIB_DIR)/smbus.ao $(LIB_DIR)/remote.ao $(LIB_DIR)/sched.ao $(LIB_DIR)/lock.ao \
+				 $(LIB_DIR)/eeprom.ao
 	$(RM) $@
 	$(AR) rcvs $@ $^
 
@@ -60,10 +63,34 @@ $(LIB_DIR)/$(LIB_STLIBNAME): $(LIB_DIR)/smbus.ao
 # once again for the static library.
 #
 
-$(LIB_DIR)/smbus.o: $(LIB_DIR)/smbus.c $(INCLUDE_DIR)/i2c/smbus.h
+$(LIB_DIR)/smbus.o: $(LIB_DIR)/smbus.c $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
 	$(CC) $(SOCFLAGS) $(LIB_CFLAGS) -c $< -o $@
 
-$(LIB_DIR)/smbus.ao: $(LIB_DIR)/smbus.c $(INCLUDE_DIR)/i2c/smbus.h
+$(LIB_DIR)/smbus.ao: $(LIB_DIR)/smbus.c $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(CFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/remote.o: $(LIB_DIR)/remote.c $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(SOCFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/remote.ao: $(LIB_DIR)/remote.c $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(CFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/sched.o: $(LIB_DIR)/sched.c $(INCLUDE_DIR)/i2c/sched.h $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(SOCFLAGS) $(LIB_CFLAGS) -pthread -c $< -o $@
+
+$(LIB_DIR)/sched.ao: $(LIB_DIR)/sched.c $(INCLUDE_DIR)/i2c/sched.h $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(CFLAGS) $(LIB_CFLAGS) -pthread -c $< -o $@
+
+$(LIB_DIR)/lock.o: $(LIB_DIR)/lock.c $(INCLUDE_DIR)/i2c/lock.h
+	$(CC) $(SOCFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/lock.ao: $(LIB_DIR)/lock.c $(INCLUDE_DIR)/i2c/lock.h
+	$(CC) $(CFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/eeprom.o: $(LIB_DIR)/eeprom.c $(INCLUDE_DIR)/i2c/eeprom.h $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
+	$(CC) $(SOCFLAGS) $(LIB_CFLAGS) -c $< -o $@
+
+$(LIB_DIR)/eeprom.ao: $(LIB_DIR)/eeprom.c $(INCLUDE_DIR)/i2c/eeprom.h $(INCLUDE_DIR)/i2c/smbus.h $(INCLUDE_DIR)/i2c/remote.h
 	$(CC) $(CFLAGS) $(LIB_CFLAGS) -c $< -o $@
 
 #
@@ -0,0 +1,453 @@
+/*
+    eeprom.c - Access to 24Cxx I2C EEPROMs
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <i2c/eeprom.h>
+#include <i2c/remote.h>
+#include <i2c/smbus.h>
+#include <linux/types.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/* Largest message i2c-dev accepts in an I2C_RDWR transfer */
+#define EEPROM_MAX_MSG		8192
+/* Interval between two polls while waiting for a write cycle */
+#define EEPROM_POLL_US		50
+
+struct i2c_eeprom {
+	int file;
+	int address;
+	unsigned long funcs;
+	struct i2c_eeprom_geometry geo;
+	int selected;		/* With I2C_SLAVE during this call, or -1 */
+	int busy;		/* Chip in a write cycle, or -1 */
+	struct timespec write_end;
+	struct i2c_eeprom_stats stats;
+};
+
+static unsigned long elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000UL +
+	       (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* Memory behind each chip address */
+static unsigned int chip_size(const struct i2c_eeprom *ee)
+{
+	return ee->geo.addr_len == 2 ? 0x10000 : 0x100;
+}
+
+static int chip_address(const struct i2c_eeprom *ee, unsigned int offset)
+{
+	return ee->address + offset / chip_size(ee);
+}
+
+/* Bytes from offset to the end of its chip, at most len */
+static size_t chip_left(const struct i2c_eeprom *ee, unsigned int offset,
+			size_t len)
+{
+	size_t left = chip_size(ee) - offset % chip_size(ee);
+
+	return left < len ? left : len;
+}
+
+static int select_chip(struct i2c_eeprom *ee, int address)
+{
+	if (address == ee->selected)
+		return 0;
+	if (i2c_ioctl(ee->file, I2C_SLAVE, address) < 0) {
+		ee->selected = -1;
+		return -errno;
+	}
+	ee->selected = address;
+	return 0;
+}
+
+static int transfer(struct i2c_eeprom *ee, struct i2c_msg *msgs, int nmsgs)
+{
+	struct i2c_rdwr_ioctl_data rdwr;
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = nmsgs;
+	return i2c_ioctl(ee->file, I2C_RDWR, &rdwr) < 0 ? -errno : 0;
+}
+
+static int check_geometry(const struct i2c_eeprom_geometry *geo,
+			  unsigned long funcs)
+{
+	unsigned int chip, need;
+
+	if (geo->addr_len != 1 && geo->addr_len != 2)
+		return -EINVAL;
+	chip = geo->addr_len == 2 ? 0x10000 : 0x100;
+	if (!geo->size || geo->size > 8 * chip || !geo->page_size ||
+	    geo->page_size > I2C_EEPROM_MAX_PAGE_SIZE)
+		return -EINVAL;
+
+	if (funcs & I2C_FUNC_I2C)
+		return 0;
+	/* Memory address write then byte reads, and byte writes */
+	need = I2C_FUNC_SMBUS_READ_BYTE | I2C_FUNC_SMBUS_WRITE_BYTE_DATA;
+	need |= geo->addr_len == 2 ? I2C_FUNC_SMBUS_WRITE_WORD_DATA :
+				     I2C_FUNC_SMBUS_WRITE_BYTE;
+	return (funcs & need) == need ? 0 : -EOPNOTSUPP;
+}
+
+/* The chip doesn't acknowledge its address during a write cycle. Poll
+   with a read, a quick write (or a zero-length I2C write, the same thing
+   on the wire) is known to corrupt the Atmel AT24RF08. The successful
+   poll moves the address pointer of the chip by one byte, as documented
+   for i2c_eeprom_read_current(). */
+static int poll_chip(struct i2c_eeprom *ee)
+{
+	struct i2c_msg msg;
+	__u8 byte;
+	int r;
+
+	if (ee->funcs & I2C_FUNC_I2C) {
+		msg.addr = ee->busy;
+		msg.flags = I2C_M_RD;
+		msg.len = 1;
+		msg.buf = &byte;
+		return transfer(ee, &msg, 1);
+	}
+	r = select_chip(ee, ee->busy);
+	return r ? r : i2c_smbus_read_byte(ee->file);
+}
+
+static int wait_ready(struct i2c_eeprom *ee)
+{
+	unsigned long us;
+
+	if (ee->busy < 0)
+		return 0;
+	for (;;) {
+		if (poll_chip(ee) >= 0)
+			break;
+		us = elapsed_us(&ee->write_end);
+		if (us >= ee->geo.write_timeout_us) {
+			ee->busy = -1;
+			return -ETIMEDOUT;
+		}
+		usleep(EEPROM_POLL_US);
+	}
+	us = elapsed_us(&ee->write_end);
+	ee->busy = -1;
+
+	ee->stats.write_cycles++;
+	ee->stats.total_us += us;
+	if (us < ee->stats.min_us)
+		ee->stats.min_us = us;
+	if (us > ee->stats.max_us)
+		ee->stats.max_us = us;
+	return 0;
+}
+
+/* Write the memory address, for the current address reads that follow */
+static int smbus_set_offset(struct i2c_eeprom *ee, unsigned int offset)
+{
+	if (ee->geo.addr_len == 2)
+		return i2c_smbus_write_byte_data(ee->file, (offset >> 8) & 0xff,
+						 offset & 0xff);
+	return i2c_smbus_write_byte(ee->file, offset & 0xff);
+}
+
+/* Read from a single chip */
+static int read_chip(struct i2c_eeprom *ee, unsigned int offset, __u8 *buf,
+		     size_t len)
+{
+	struct i2c_msg msgs[2];
+	__u8 abuf[2];
+	size_t n;
+	int r;
+
+	if (ee->funcs & I2C_FUNC_I2C) {
+		/* Address write and sequential read, with a repeated start */
+		for (; len; offset += n, buf += n, len -= n) {
+			n = len < EEPROM_MAX_MSG ? len : EEPROM_MAX_MSG;
+			r = 0;
+			if (ee->geo.addr_len == 2)
+				abuf[r++] = (offset >> 8) & 0xff;
+			abuf[r++] = offset & 0xff;
+			msgs[0].addr = chip_address(ee, offset);
+			msgs[0].flags = 0;
+			msgs[0].len = r;
+			msgs[0].buf = abuf;
+			msgs[1].addr = msgs[0].addr;
+			msgs[1].flags = I2C_M_RD;
+			msgs[1].len = n;
+			msgs[1].buf = buf;
+			r = transfer(ee, msgs, 2);
+			if (r < 0)
+				return r;
+		}
+		return 0;
+	}
+
+	r = select_chip(ee, chip_address(ee, offset));
+	if (r < 0)
+		return r;
+
+	/* The command byte of SMBus I2C block reads can only carry an
+	   8-bit address */
+	if (ee->geo.addr_len == 1 &&
+	    (ee->funcs & I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+		while (len) {
+			n = len < I2C_SMBUS_BLOCK_MAX ? len : I2C_SMBUS_BLOCK_MAX;
+			r = i2c_smbus_read_i2c_block_data(ee->file,
+					offset & 0xff, n, buf);
+			if (r < 0)
+				return r;
+			if (r == 0)
+				return -EIO;
+			offset += r;
+			buf += r;
+			len -= r;
+		}
+		return 0;
+	}
+
+	r = smbus_set_offset(ee, offset);
+	for (; r >= 0 && len; len--) {
+		r = i2c_smbus_read_byte(ee->file);
+		if (r >= 0)
+			*buf++ = r;
+	}
+	return r < 0 ? r : 0;
+}
+
+/* Largest write the adapter can do in one transaction */
+static size_t max_write(const struct i2c_eeprom *ee)
+{
+	if (ee->funcs & I2C_FUNC_I2C)
+		return I2C_EEPROM_MAX_PAGE_SIZE;
+	/* The low address byte of 16-bit parts takes a byte of the block */
+	if (ee->funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)
+		return ee->geo.addr_len == 2 ? I2C_SMBUS_BLOCK_MAX - 1 :
+					       I2C_SMBUS_BLOCK_MAX;
+	return 1;
+}
+
+/* Start a write, within a page */
+static int write_chunk(struct i2c_eeprom *ee, unsigned int offset,
+		       const __u8 *data, size_t len)
+{
+	__u8 buf[2 + I2C_EEPROM_MAX_PAGE_SIZE];
+	struct i2c_msg msg;
+	int address = chip_address(ee, offset), n = 0, r;
+
+	if (ee->geo.addr_len == 2)
+		buf[n++] = (offset >> 8) & 0xff;
+	buf[n++] = offset & 0xff;
+
+	if (ee->funcs & I2C_FUNC_I2C) {
+		memcpy(buf + n, data, len);
+		msg.addr = address;
+		msg.flags = 0;
+		msg.len = n + len;
+		msg.buf = buf;
+		r = transfer(ee, &msg, 1);
+	} else {
+		r = select_chip(ee, address);
+		if (r < 0)
+			return r;
+		if (len > 1) {
+			/* The first address byte is the command */
+			memcpy(buf + n, data, len);
+			r = i2c_smbus_write_i2c_block_data(ee->file, buf[0],
+							   n - 1 + len, buf + 1);
+		} else if (n == 2) {
+			/* The word is sent low byte first */
+			r = i2c_smbus_write_word_data(ee->file, buf[0],
+						      *data << 8 | buf[1]);
+		} else {
+			r = i2c_smbus_write_byte_data(ee->file, buf[0], *data);
+		}
+	}
+	if (r < 0)
+		return r;
+
+	clock_gettime(CLOCK_MONOTONIC, &ee->write_end);
+	ee->busy = address;
+	return 0;
+}
+
+static int check_range(const struct i2c_eeprom *ee, unsigned int offset,
+		       size_t len)
+{
+	return offset > ee->geo.size || len > ee->geo.size - offset ?
+	       -EINVAL : 0;
+}
+
+struct i2c_eeprom *i2c_eeprom_open(int file, int address,
+				   const struct i2c_eeprom_geometry *geo)
+{
+	struct i2c_eeprom *ee;
+	unsigned long funcs;
+	int r;
+
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0)
+		return NULL;
+	ee = calloc(1, sizeof(*ee));
+	if (!ee)
+		return NULL;
+	ee->file = file;
+	ee->address = address;
+	ee->funcs = funcs;
+	ee->selected = -1;
+	ee->busy = -1;
+	ee->stats.min_us = ULONG_MAX;
+
+	r = i2c_eeprom_set_geometry(ee, geo);
+	if (!r)
+		r = select_chip(ee, address);
+	if (r) {
+		free(ee);
+		errno = -r;
+		return NULL;
+	}
+	return ee;
+}
+
+void i2c_eeprom_close(struct i2c_eeprom *ee)
+{
+	i2c_eeprom_sync(ee);
+	free(ee);
+}
+
+int i2c_eeprom_set_geometry(struct i2c_eeprom *ee,
+			    const struct i2c_eeprom_geometry *geo)
+{
+	int r;
+
+	r = check_geometry(geo, ee->funcs);
+	if (r)
+		return r;
+	ee->geo = *geo;
+	if (!ee->geo.write_timeout_us)
+		ee->geo.write_timeout_us = I2C_EEPROM_WRITE_TIMEOUT_US;
+	return 0;
+}
+
+int i2c_eeprom_read(struct i2c_eeprom *ee, unsigned int offset, void *buf,
+		    size_t len)
+{
+	__u8 *p = buf;
+	size_t n;
+	int r;
+
+	r = check_range(ee, offset, len);
+	if (r)
+		return r;
+	ee->selected = -1;
+	r = wait_ready(ee);
+	if (r)
+		return r;
+
+	/* Reads don't cross chip addresses */
+	for (; len; offset += n, p += n, len -= n) {
+		n = chip_left(ee, offset, len);
+		r = read_chip(ee, offset, p, n);
+		if (r)
+			return r;
+	}
+	return 0;
+}
+
+int i2c_eeprom_read_current(struct i2c_eeprom *ee, void *buf, size_t len)
+{
+	struct i2c_msg msg;
+	__u8 *p = buf;
+	size_t n;
+	int r;
+
+	ee->selected = -1;
+	r = wait_ready(ee);
+	if (r)
+		return r;
+
+	if (ee->funcs & I2C_FUNC_I2C) {
+		for (; len; p += n, len -= n) {
+			n = len < EEPROM_MAX_MSG ? len : EEPROM_MAX_MSG;
+			msg.addr = ee->address;
+			msg.flags = I2C_M_RD;
+			msg.len = n;
+			msg.buf = p;
+			r = transfer(ee, &msg, 1);
+			if (r)
+				return r;
+		}
+		return 0;
+	}
+
+	r = select_chip(ee, ee->address);
+	for (; r >= 0 && len; len--) {
+		r = i2c_smbus_read_byte(ee->file);
+		if (r >= 0)
+			*p++ = r;
+	}
+	return r < 0 ? r : 0;
+}
+
+int i2c_eeprom_write(struct i2c_eeprom *ee, unsigned int offset,
+		     const void *buf, size_t len)
+{
+	const __u8 *p = buf;
+	size_t n, max = max_write(ee);
+	int r;
+
+	r = check_range(ee, offset, len);
+	if (r)
+		return r;
+	ee->selected = -1;
+
+	for (; len; offset += n, p += n, len -= n) {
+		n = ee->geo.page_size - offset % ee->geo.page_size;
+		if (n > len)
+			n = len;
+		if (n > max)
+			n = max;
+		n = chip_left(ee, offset, n);
+
+		r = wait_ready(ee);
+		if (r)
+			return r;
+		r = write_chunk(ee, offset, p, n);
+		if (r)
+			return r;
+	}
+	return 0;
+}
+
+int i2c_eeprom_sync(struct i2c_eeprom *ee)
+{
+	ee->selected = -1;
+	return wait_ready(ee);
+}
+
+void i2c_eeprom_get_stats(struct i2c_eeprom *ee,
+			  struct i2c_eeprom_stats *stats)
+{
+	*stats = ee->stats;
+}
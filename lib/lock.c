@@ -0,0 +1,106 @@
+/*
+    lock.c - Advisory locking of I2C chips across processes
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <i2c/lock.h>
+#include <sys/file.h>
+
+/* Retry intervals while waiting for a lock, in microseconds */
+#define LOCK_MIN_INTERVAL	500
+#define LOCK_MAX_INTERVAL	20000
+
+static long elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L +
+	       (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+int i2c_lock_chip(int i2cbus, int address, int timeout_ms)
+{
+	char path[PATH_MAX];
+	const char *dir;
+	struct timespec start, delay;
+	long interval = LOCK_MIN_INTERVAL, left;
+	int lock, err;
+
+	dir = getenv("I2C_LOCK_DIR");
+	if (!dir || !*dir)
+		dir = I2C_LOCK_DIR;
+	if (snprintf(path, sizeof(path), "%s/i2c-%d-%04x.lock", dir, i2cbus,
+		     address) >= (int)sizeof(path))
+		return -ENAMETOOLONG;
+
+	/* flock() doesn't need write access, and the lock files are never
+	   removed, as that would race with other lockers. The directory is
+	   usually world-writable, don't follow links planted there. */
+	lock = open(path, O_RDONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0666);
+	if (lock < 0)
+		return -errno;
+
+	if (timeout_ms < 0) {
+		while (flock(lock, LOCK_EX) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			close(lock);
+			return err;
+		}
+		return lock;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (flock(lock, LOCK_EX | LOCK_NB) < 0) {
+		if (errno != EWOULDBLOCK && errno != EINTR) {
+			err = -errno;
+			close(lock);
+			return err;
+		}
+
+		left = timeout_ms * 1000L - elapsed_us(&start);
+		if (left <= 0) {
+			close(lock);
+			return -ETIMEDOUT;
+		}
+		if (interval > left)
+			interval = left;
+		delay.tv_sec = interval / 1000000;
+		delay.tv_nsec = (interval % 1000000) * 1000;
+		nanosleep(&delay, NULL);
+
+		interval *= 2;
+		if (interval > LOCK_MAX_INTERVAL)
+			interval = LOCK_MAX_INTERVAL;
+	}
+
+	return lock;
+}
+
+void i2c_unlock_chip(int lock)
+{
+	if (lock < 0)
+		return;
+	flock(lock, LOCK_UN);
+	close(lock);
+}
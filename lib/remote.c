@@ -0,0 +1,584 @@
+/*
+    remote.c - Access to I2C buses through the i2cd daemon
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+/* For memfd_create and F_ADD_SEALS */
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <i2c/remote.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <linux/types.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/* Sockets are only ever i2cd connections for us */
+static int is_remote(int file)
+{
+	struct stat st;
+
+	return fstat(file, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+static int read_full(int file, void *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = read(file, buf, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			if (ret == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		buf = (char *)buf + ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* The file descriptors, if any, are passed along with the first byte */
+static int write_full(int file, struct iovec *iov, int iovcnt,
+		      const int *fds, int nfds)
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	ssize_t ret;
+
+	while (iovcnt) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iovcnt;
+		if (nfds) {
+			msg.msg_control = control.buf;
+			msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+		}
+
+		ret = sendmsg(file, &msg, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return -1;
+		nfds = 0;
+
+		while (iovcnt && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Send a request, with nfds file descriptors attached, and wait for its
+ * reply. The payload is given as iov[1] onwards, iov[0] is filled with
+ * the request header. The reply payload is scattered to riov. Returns
+ * the reply ret value, or -1 with errno set.
+ */
+static int remote_call_fds(int file, __u32 op, __u32 arg, struct iovec *iov,
+			   int iovcnt, const struct iovec *riov, int riovcnt,
+			   const int *fds, int nfds)
+{
+	struct i2cd_request req;
+	struct i2cd_reply rep;
+	char discard[64];
+	size_t len, left;
+	int i;
+
+	req.op = op;
+	req.arg = arg;
+	req.len = 0;
+	for (i = 1; i < iovcnt; i++)
+		req.len += iov[i].iov_len;
+	iov[0].iov_base = &req;
+	iov[0].iov_len = sizeof(req);
+
+	if (write_full(file, iov, iovcnt, fds, nfds) ||
+	    read_full(file, &rep, sizeof(rep)))
+		return -1;
+
+	left = rep.len;
+	for (i = 0; i < riovcnt && left; i++) {
+		len = riov[i].iov_len < left ? riov[i].iov_len : left;
+		if (read_full(file, riov[i].iov_base, len))
+			return -1;
+		left -= len;
+	}
+	/* Should not happen, but stay in sync with the daemon */
+	while (left) {
+		len = left < sizeof(discard) ? left : sizeof(discard);
+		if (read_full(file, discard, len))
+			return -1;
+		left -= len;
+	}
+
+	if (rep.ret < 0) {
+		errno = -rep.ret;
+		return -1;
+	}
+	return rep.ret;
+}
+
+static int remote_call(int file, __u32 op, __u32 arg, struct iovec *iov,
+		       int iovcnt, const struct iovec *riov, int riovcnt)
+{
+	return remote_call_fds(file, op, arg, iov, iovcnt, riov, riovcnt,
+			       NULL, 0);
+}
+
+static int remote_smbus(int file, struct i2c_smbus_ioctl_data *args)
+{
+	struct i2cd_smbus smbus;
+	struct iovec iov[2];
+	int ret;
+
+	memset(&smbus, 0, sizeof(smbus));
+	smbus.read_write = args->read_write;
+	smbus.command = args->command;
+	smbus.size = args->size;
+	if (args->data)
+		smbus.data = *args->data;
+
+	iov[1].iov_base = &smbus;
+	iov[1].iov_len = sizeof(smbus);
+	ret = remote_call(file, I2CD_SMBUS, 0, iov, 2, &iov[1], 1);
+	if (ret >= 0 && args->data)
+		*args->data = smbus.data;
+
+	return ret;
+}
+
+static int remote_rdwr(int file, struct i2c_rdwr_ioctl_data *rdwr)
+{
+	struct i2cd_msg msgs[I2C_RDRW_IOCTL_MAX_MSGS];
+	struct iovec iov[2 + I2C_RDRW_IOCTL_MAX_MSGS];
+	struct iovec riov[I2C_RDRW_IOCTL_MAX_MSGS];
+	struct i2cd_msg *m;
+	unsigned i;
+	int iovcnt = 2, riovcnt = 0;
+
+	if (rdwr->nmsgs > I2C_RDRW_IOCTL_MAX_MSGS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < rdwr->nmsgs; i++) {
+		m = &msgs[i];
+		m->addr = rdwr->msgs[i].addr;
+		m->flags = rdwr->msgs[i].flags;
+		m->len = rdwr->msgs[i].len;
+		m->reserved = 0;
+
+		if (m->flags & I2C_M_RD) {
+			riov[riovcnt].iov_base = rdwr->msgs[i].buf;
+			riov[riovcnt].iov_len = m->len;
+			riovcnt++;
+		} else if (m->len) {
+			iov[iovcnt].iov_base = rdwr->msgs[i].buf;
+			iov[iovcnt].iov_len = m->len;
+			iovcnt++;
+		}
+	}
+	iov[1].iov_base = msgs;
+	iov[1].iov_len = rdwr->nmsgs * sizeof(*msgs);
+
+	/* Read data comes back concatenated */
+	return remote_call(file, I2CD_RDWR, rdwr->nmsgs, iov, iovcnt, riov,
+			   riovcnt);
+}
+
+static int remote_ioctl(int file, unsigned long request, unsigned long arg)
+{
+	struct iovec iov[1], riov[1];
+	__u64 funcs;
+	int ret;
+
+	switch (request) {
+	case I2C_FUNCS:
+		riov[0].iov_base = &funcs;
+		riov[0].iov_len = sizeof(funcs);
+		ret = remote_call(file, I2CD_FUNCS, 0, iov, 1, riov, 1);
+		if (ret >= 0)
+			*(unsigned long *)arg = funcs;
+		return ret;
+	case I2C_SLAVE:
+		return remote_call(file, I2CD_SLAVE, arg, iov, 1, NULL, 0);
+	case I2C_SLAVE_FORCE:
+		return remote_call(file, I2CD_SLAVE_FORCE, arg, iov, 1, NULL, 0);
+	case I2C_PEC:
+		return remote_call(file, I2CD_PEC, !!arg, iov, 1, NULL, 0);
+	case I2C_SMBUS:
+		return remote_smbus(file, (struct i2c_smbus_ioctl_data *)arg);
+	case I2C_RDWR:
+		return remote_rdwr(file, (struct i2c_rdwr_ioctl_data *)arg);
+	default:
+		errno = ENOTTY;
+		return -1;
+	}
+}
+
+int i2c_remote_open(const char *socket_path, int i2cbus)
+{
+	struct sockaddr_un addr;
+	struct iovec iov[1];
+	int file, err;
+
+	if (!socket_path)
+		socket_path = I2CD_SOCKET;
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	file = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (file < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	if (connect(file, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    remote_call(file, I2CD_OPEN, i2cbus, iov, 1, NULL, 0) < 0) {
+		err = errno;
+		close(file);
+		errno = err;
+		return -1;
+	}
+
+	return file;
+}
+
+int i2c_ioctl(int file, unsigned long request, ...)
+{
+	unsigned long arg;
+	va_list ap;
+	int ret;
+
+	va_start(ap, request);
+	arg = va_arg(ap, unsigned long);
+	va_end(ap);
+
+	/* Sockets don't know the i2c-dev requests, so local files only
+	   pay for the extra check when the ioctl fails */
+	ret = ioctl(file, request, arg);
+	if (ret >= 0 || errno != ENOTTY || !is_remote(file))
+		return ret;
+
+	return remote_ioctl(file, request, arg);
+}
+
+int i2c_flock(int file, int operation)
+{
+	struct iovec iov[1];
+
+	if (!is_remote(file))
+		return flock(file, operation);
+
+	/* Waiting is the only option, i2cd doesn't answer until the lock
+	   is free */
+	return remote_call(file, I2CD_LOCK, operation & ~LOCK_NB, iov, 1,
+			   NULL, 0) < 0 ? -1 : 0;
+}
+
+struct i2c_ring {
+	int file;		/* i2cd connection */
+	int sq_fd, cq_fd;	/* Doorbells */
+	void *map;
+	size_t map_size;
+	unsigned int entries, slot_size;
+
+	struct i2c_ring_index *sq, *cq;
+	struct i2c_ring_sqe *sqes;
+	struct i2c_ring_cqe *cqes;
+	__u8 *slots;
+
+	__u32 sq_tail;		/* Queued, published on submit */
+	__u32 cq_head;		/* Reaped */
+};
+
+struct i2c_ring *i2c_ring_open(const char *socket_path, int i2cbus,
+			       unsigned int entries, unsigned int slot_size)
+{
+	struct i2c_ring *ring;
+	struct iovec iov[2];
+	__u32 size = slot_size;
+	int memfd, fds[3], err;
+
+	/* i2cd checks the rest */
+	if (!entries || (entries & (entries - 1)) ||
+	    entries > I2C_RING_MAX_ENTRIES || slot_size % 8) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+	ring->file = ring->sq_fd = ring->cq_fd = memfd = -1;
+	ring->map = MAP_FAILED;
+	ring->entries = entries;
+	ring->slot_size = slot_size;
+	ring->map_size = I2C_RING_SIZE(entries, slot_size);
+
+	/* Sealed so that i2cd can trust the size */
+	memfd = memfd_create("i2c-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memfd < 0 || ftruncate(memfd, ring->map_size) < 0 ||
+	    fcntl(memfd, F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+		goto fail;
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, memfd, 0);
+	if (ring->map == MAP_FAILED)
+		goto fail;
+
+	ring->sq = ring->map;
+	ring->cq = ring->sq + 1;
+	ring->sqes = (struct i2c_ring_sqe *)(ring->cq + 1);
+	ring->cqes = (struct i2c_ring_cqe *)(ring->sqes + entries);
+	ring->slots = (__u8 *)(ring->cqes + entries);
+
+	ring->sq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	ring->cq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ring->sq_fd < 0 || ring->cq_fd < 0)
+		goto fail;
+
+	ring->file = i2c_remote_open(socket_path, i2cbus);
+	if (ring->file < 0)
+		goto fail;
+
+	fds[0] = memfd;
+	fds[1] = ring->sq_fd;
+	fds[2] = ring->cq_fd;
+	iov[1].iov_base = &size;
+	iov[1].iov_len = sizeof(size);
+	if (remote_call_fds(ring->file, I2CD_RING, entries, iov, 2, NULL, 0,
+			    fds, 3) < 0)
+		goto fail;
+
+	close(memfd);
+	return ring;
+
+fail:
+	err = errno;
+	if (memfd >= 0)
+		close(memfd);
+	i2c_ring_close(ring);
+	errno = err;
+	return NULL;
+}
+
+void i2c_ring_close(struct i2c_ring *ring)
+{
+	if (!ring)
+		return;
+	if (ring->file >= 0)
+		close(ring->file);
+	if (ring->sq_fd >= 0)
+		close(ring->sq_fd);
+	if (ring->cq_fd >= 0)
+		close(ring->cq_fd);
+	if (ring->map != MAP_FAILED)
+		munmap(ring->map, ring->map_size);
+	free(ring);
+}
+
+int i2c_ring_file(struct i2c_ring *ring)
+{
+	return ring->file;
+}
+
+void *i2c_ring_slot(struct i2c_ring *ring, unsigned int slot)
+{
+	if (slot >= ring->entries)
+		return NULL;
+	return ring->slots + (size_t)slot * ring->slot_size;
+}
+
+/* Get the next submission entry and its slot, which go together */
+static struct i2c_ring_sqe *ring_get_sqe(struct i2c_ring *ring, __u64 user_data,
+					 __u8 **slot)
+{
+	struct i2c_ring_sqe *sqe;
+	unsigned int n;
+
+	/* Slots are reused in order, so a slot is free once the completion
+	   of the transaction which used it last has been reaped */
+	if (ring->sq_tail - ring->cq_head >= ring->entries)
+		return NULL;
+
+	n = ring->sq_tail & (ring->entries - 1);
+	sqe = &ring->sqes[n];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = user_data;
+	sqe->slot = n;
+	*slot = ring->slots + (size_t)n * ring->slot_size;
+
+	return sqe;
+}
+
+int i2c_ring_queue_smbus(struct i2c_ring *ring, __u16 addr, int flags,
+			 char read_write, __u8 command, int size,
+			 const union i2c_smbus_data *data, __u64 user_data)
+{
+	struct i2c_ring_sqe *sqe;
+	struct i2cd_smbus *smbus;
+	__u8 *slot;
+
+	sqe = ring_get_sqe(ring, user_data, &slot);
+	if (!sqe)
+		return -EAGAIN;
+
+	smbus = (struct i2cd_smbus *)slot;
+	memset(smbus, 0, sizeof(*smbus));
+	smbus->read_write = read_write;
+	smbus->command = command;
+	smbus->size = size;
+	if (data)
+		smbus->data = *data;
+
+	sqe->op = I2CD_SMBUS;
+	sqe->addr = addr;
+	sqe->flags = flags & (I2C_RING_FORCE | I2C_RING_PEC);
+	sqe->len = sizeof(*smbus);
+	ring->sq_tail++;
+
+	return sqe->slot;
+}
+
+int i2c_ring_queue_rdwr(struct i2c_ring *ring, const struct i2c_msg *msgs,
+			unsigned int nmsgs, __u64 user_data)
+{
+	struct i2c_ring_sqe *sqe;
+	struct i2cd_msg *m;
+	size_t wr = nmsgs * sizeof(*m), rd = 0;
+	unsigned int i;
+	__u8 *slot;
+
+	if (!nmsgs || nmsgs > I2C_RDRW_IOCTL_MAX_MSGS)
+		return -EINVAL;
+	for (i = 0; i < nmsgs; i++) {
+		if (msgs[i].flags & I2C_M_RD)
+			rd += msgs[i].len;
+		else
+			wr += msgs[i].len;
+	}
+	if (wr > ring->slot_size || rd > ring->slot_size)
+		return -EINVAL;
+
+	sqe = ring_get_sqe(ring, user_data, &slot);
+	if (!sqe)
+		return -EAGAIN;
+
+	/* Same layout as an I2CD_RDWR request payload */
+	m = (struct i2cd_msg *)slot;
+	wr = nmsgs * sizeof(*m);
+	for (i = 0; i < nmsgs; i++) {
+		m[i].addr = msgs[i].addr;
+		m[i].flags = msgs[i].flags;
+		m[i].len = msgs[i].len;
+		m[i].reserved = 0;
+		if (!(msgs[i].flags & I2C_M_RD)) {
+			memcpy(slot + wr, msgs[i].buf, msgs[i].len);
+			wr += msgs[i].len;
+		}
+	}
+
+	sqe->op = I2CD_RDWR;
+	sqe->len = wr;
+	sqe->nmsgs = nmsgs;
+	ring->sq_tail++;
+
+	return sqe->slot;
+}
+
+int i2c_ring_submit(struct i2c_ring *ring)
+{
+	if (ring->sq->tail == ring->sq_tail)
+		return 0;
+
+	/* Entries and slots must be visible before the new tail */
+	__atomic_store_n(&ring->sq->tail, ring->sq_tail, __ATOMIC_RELEASE);
+	if (eventfd_write(ring->sq_fd, 1) < 0)
+		return -errno;
+
+	return 0;
+}
+
+int i2c_ring_reap(struct i2c_ring *ring, struct i2c_ring_cqe *cqe, int wait)
+{
+	struct pollfd pfd[2];
+	eventfd_t count;
+
+	for (;;) {
+		if (ring->cq_head != __atomic_load_n(&ring->cq->tail,
+						     __ATOMIC_ACQUIRE)) {
+			*cqe = ring->cqes[ring->cq_head & (ring->entries - 1)];
+			__atomic_store_n(&ring->cq->head, ++ring->cq_head,
+					 __ATOMIC_RELEASE);
+			return 1;
+		}
+
+		/* Don't wait for what was never submitted */
+		if (!wait || ring->cq_head == ring->sq->tail)
+			return 0;
+
+		/* Also watch the connection, in case i2cd goes away */
+		pfd[0].fd = ring->cq_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = ring->file;
+		pfd[1].events = 0;
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (pfd[1].revents & (POLLHUP | POLLERR))
+			return -ECONNRESET;
+		if (pfd[0].revents & POLLIN)
+			eventfd_read(ring->cq_fd, &count);
+	}
+}
@@ -0,0 +1,332 @@
+/*
+    sched.c - Priority and deadline scheduling of I2C transactions
+
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <i2c/remote.h>
+#include <i2c/sched.h>
+#include <i2c/smbus.h>
+#include <linux/types.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define NO_DEADLINE	(~(__u64)0)
+
+enum { REQ_IDLE, REQ_QUEUED, REQ_DONE };
+
+struct i2c_sched {
+	int file;
+	unsigned int chunk;
+	int addr, force, pec;	/* Current settings of file, -1 if unknown */
+
+	pthread_mutex_t lock;	/* Protects everything below */
+	pthread_mutex_t exec;	/* Held while using the bus */
+	pthread_cond_t queued, done;
+	struct i2c_sched_req *queue[I2C_SCHED_CLASSES];
+	struct i2c_sched_stats stats;
+
+	pthread_t thread;
+	int started, stop;
+};
+
+static __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct i2c_sched *i2c_sched_new(int file, unsigned int chunk)
+{
+	struct i2c_sched *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->file = file;
+	s->chunk = chunk && chunk < I2C_SMBUS_BLOCK_MAX ? chunk :
+		   I2C_SMBUS_BLOCK_MAX;
+	s->addr = s->force = s->pec = -1;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_mutex_init(&s->exec, NULL);
+	pthread_cond_init(&s->queued, NULL);
+	pthread_cond_init(&s->done, NULL);
+
+	return s;
+}
+
+static void *worker(void *arg)
+{
+	struct i2c_sched *s = arg;
+
+	while (i2c_sched_run(s, 1))
+		;
+	return NULL;
+}
+
+int i2c_sched_start(struct i2c_sched *s)
+{
+	int err;
+
+	pthread_mutex_lock(&s->lock);
+	if (s->started) {
+		pthread_mutex_unlock(&s->lock);
+		return -EBUSY;
+	}
+	err = pthread_create(&s->thread, NULL, worker, s);
+	if (!err)
+		s->started = 1;
+	pthread_mutex_unlock(&s->lock);
+
+	return -err;
+}
+
+/* Dequeue a request and report its completion, called with the lock held */
+static void complete(struct i2c_sched *s, struct i2c_sched_req *req, int ret)
+{
+	struct i2c_sched_req **p;
+	int c = req->sched_class;
+	__u64 now;
+
+	/* Not necessarily the head, an earlier deadline may have come in
+	   meanwhile */
+	for (p = &s->queue[c]; *p != req; p = &(*p)->next)
+		;
+	*p = req->next;
+	req->next = NULL;
+	req->ret = ret;
+	req->missed = 0;
+	req->late_ns = 0;
+
+	if (req->due_ns != NO_DEADLINE) {
+		now = now_ns();
+		if (now > req->due_ns) {
+			req->missed = 1;
+			req->late_ns = now - req->due_ns;
+			s->stats.missed[c]++;
+			if (req->late_ns > s->stats.max_late_ns[c])
+				s->stats.max_late_ns[c] = req->late_ns;
+		}
+	}
+	s->stats.completed[c]++;
+	req->state = REQ_DONE;
+	pthread_cond_broadcast(&s->done);
+}
+
+void i2c_sched_free(struct i2c_sched *s)
+{
+	struct i2c_sched_req *req;
+	void (*cb)(struct i2c_sched_req *);
+	int c;
+
+	if (!s)
+		return;
+
+	pthread_mutex_lock(&s->lock);
+	s->stop = 1;
+	pthread_cond_broadcast(&s->queued);
+	pthread_mutex_unlock(&s->lock);
+	if (s->started)
+		pthread_join(s->thread, NULL);
+
+	pthread_mutex_lock(&s->lock);
+	for (c = 0; c < I2C_SCHED_CLASSES; c++) {
+		while ((req = s->queue[c])) {
+			cb = req->complete;
+			complete(s, req, -ECANCELED);
+			if (cb) {
+				pthread_mutex_unlock(&s->lock);
+				cb(req);
+				pthread_mutex_lock(&s->lock);
+			}
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	pthread_cond_destroy(&s->queued);
+	pthread_cond_destroy(&s->done);
+	pthread_mutex_destroy(&s->exec);
+	pthread_mutex_destroy(&s->lock);
+	free(s);
+}
+
+int i2c_sched_submit(struct i2c_sched *s, struct i2c_sched_req *req)
+{
+	struct i2c_sched_req **p;
+
+	if (req->sched_class < 0 || req->sched_class >= I2C_SCHED_CLASSES)
+		return -EINVAL;
+	switch (req->type) {
+	case I2C_SCHED_SMBUS:
+		break;
+	case I2C_SCHED_BLOCK_READ:
+		/* Register addresses are 8-bit */
+		if (!req->len || req->command + req->len > 256)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&s->lock);
+	if (req->state == REQ_QUEUED || s->stop) {
+		pthread_mutex_unlock(&s->lock);
+		return req->state == REQ_QUEUED ? -EBUSY : -ESHUTDOWN;
+	}
+	/* A queued request belongs to the bus thread, don't touch it
+	   before knowing it isn't */
+	req->state = REQ_QUEUED;
+	req->done = 0;
+	req->due_ns = req->deadline_us ?
+		      now_ns() + (__u64)req->deadline_us * 1000 : NO_DEADLINE;
+
+	/* Earliest deadline first, then first come, first served. The head
+	   of a queue may be partially done, which doesn't matter. */
+	for (p = &s->queue[req->sched_class]; *p; p = &(*p)->next)
+		if ((*p)->due_ns > req->due_ns)
+			break;
+	req->next = *p;
+	*p = req;
+
+	pthread_cond_signal(&s->queued);
+	pthread_mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+/* Set up the file for the transaction, called with exec held */
+static int select_chip(struct i2c_sched *s, const struct i2c_sched_req *req)
+{
+	int force = !!(req->flags & I2C_SCHED_FORCE);
+	int pec = !!(req->flags & I2C_SCHED_PEC);
+
+	if (s->addr != req->addr || s->force != force) {
+		if (i2c_ioctl(s->file, force ? I2C_SLAVE_FORCE : I2C_SLAVE,
+			      req->addr) < 0) {
+			s->addr = -1;
+			return -errno;
+		}
+		s->addr = req->addr;
+		s->force = force;
+	}
+
+	if (s->pec != pec) {
+		if (i2c_ioctl(s->file, I2C_PEC, pec) < 0) {
+			s->pec = -1;
+			return -errno;
+		}
+		s->pec = pec;
+	}
+
+	return 0;
+}
+
+int i2c_sched_run(struct i2c_sched *s, int wait)
+{
+	struct i2c_sched_req *req = NULL;
+	void (*cb)(struct i2c_sched_req *);
+	unsigned int len;
+	int c, ret;
+
+	pthread_mutex_lock(&s->exec);
+	pthread_mutex_lock(&s->lock);
+	for (;;) {
+		for (c = 0; c < I2C_SCHED_CLASSES && !req && !s->stop; c++)
+			req = s->queue[c];
+		if (req || !wait || s->stop)
+			break;
+		pthread_cond_wait(&s->queued, &s->lock);
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	if (!req) {
+		pthread_mutex_unlock(&s->exec);
+		return 0;
+	}
+
+	/* Nobody else removes queued requests while we hold exec */
+	ret = select_chip(s, req);
+	if (ret >= 0) {
+		switch (req->type) {
+		case I2C_SCHED_SMBUS:
+			ret = i2c_smbus_access(s->file, req->read_write,
+					       req->command, req->size,
+					       req->data);
+			break;
+		case I2C_SCHED_BLOCK_READ:
+			len = req->len - req->done;
+			if (len > s->chunk)
+				len = s->chunk;
+			ret = i2c_smbus_read_i2c_block_data(s->file,
+						req->command + req->done, len,
+						req->buf + req->done);
+			if (ret == 0)
+				ret = -EIO;
+			if (ret > 0) {
+				req->done += ret;
+				ret = req->done;
+			}
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&s->lock);
+	cb = NULL;
+	if (ret < 0 || req->type != I2C_SCHED_BLOCK_READ ||
+	    req->done == req->len) {
+		cb = req->complete;
+		complete(s, req, ret);
+	}
+	pthread_mutex_unlock(&s->lock);
+	pthread_mutex_unlock(&s->exec);
+
+	if (cb)
+		cb(req);
+
+	return 1;
+}
+
+int i2c_sched_wait(struct i2c_sched *s, struct i2c_sched_req *req)
+{
+	int ret;
+
+	pthread_mutex_lock(&s->lock);
+	while (req->state == REQ_QUEUED) {
+		if (s->started) {
+			pthread_cond_wait(&s->done, &s->lock);
+			continue;
+		}
+		/* No worker, do the work ourselves */
+		pthread_mutex_unlock(&s->lock);
+		i2c_sched_run(s, 0);
+		pthread_mutex_lock(&s->lock);
+	}
+	ret = req->ret;
+	pthread_mutex_unlock(&s->lock);
+
+	return ret;
+}
+
+void i2c_sched_get_stats(struct i2c_sched *s, struct i2c_sched_stats *stats)
+{
+	pthread_mutex_lock(&s->lock);
+	*stats = s->stats;
+	pthread_mutex_unlock(&s->lock);
+}
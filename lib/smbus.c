@@ -23,12 +23,19 @@
 
 #include <errno.h>
 #include <stddef.h>
+#include <time.h>
+#include <i2c/remote.h>
 #include <i2c/smbus.h>
 #include <sys/ioctl.h>
 #include <linux/types.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
+/* Polling intervals, in microseconds, after the first back to back polls */
+#define POLL_BACK_TO_BACK	4
+#define POLL_MIN_INTERVAL	50
+#define POLL_MAX_INTERVAL	10000
+
 /* Compatibility defines */
 #ifndef I2C_SMBUS_I2C_BLOCK_BROKEN
 #define I2C_SMBUS_I2C_BLOCK_BROKEN I2C_SMBUS_I2C_BLOCK_DATA
@@ -48,7 +55,7 @@ __s32 i2c_smbus_access(int file, char read_write, __u8 command,
 	args.size = size;
 	args.data = data;
 
-	err = ioctl(file, I2C_SMBUS, &args);
+	err = i2c_ioctl(file, I2C_SMBUS, &args);
 	if (err == -1)
 		err = -errno;
 	return err;
@@ -120,6 +127,118 @@ __s32 i2c_smbus_write_word_data(int file, __u8 command, __u16 value)
 				I2C_SMBUS_WORD_DATA, &data);
 }
 
+/*
+ * Read-modify-write: only the bits set in mask are taken from value. No
+ * lock is taken, the caller keeps cooperating processes off the chip for
+ * the duration of the sequence, with i2c_lock_chip() like the tools do.
+ * Returns the previous register value.
+ */
+__s32 i2c_smbus_update_byte_data(int file, __u8 command, __u8 mask,
+				 __u8 value)
+{
+	__s32 old, err;
+
+	old = i2c_smbus_read_byte_data(file, command);
+	if (old < 0)
+		return old;
+
+	err = i2c_smbus_write_byte_data(file, command,
+					(old & ~mask) | (value & mask));
+	return err < 0 ? err : old;
+}
+
+__s32 i2c_smbus_update_word_data(int file, __u8 command, __u16 mask,
+				 __u16 value)
+{
+	__s32 old, err;
+
+	old = i2c_smbus_read_word_data(file, command);
+	if (old < 0)
+		return old;
+
+	err = i2c_smbus_write_word_data(file, command,
+					(old & ~mask) | (value & mask));
+	return err < 0 ? err : old;
+}
+
+/*
+ * Read the register until (value & mask) == match. The first
+ * POLL_BACK_TO_BACK polls are back to back, for conditions which are met
+ * right away, then the interval doubles from POLL_MIN_INTERVAL up to
+ * POLL_MAX_INTERVAL so that slow devices don't hog the bus.
+ */
+static __s32 i2c_smbus_poll(int file, __u8 command, int size, __u16 mask,
+			    __u16 match, unsigned int timeout_ms,
+			    unsigned int *polls)
+{
+	struct timespec start, now, delay;
+	long interval = POLL_MIN_INTERVAL, left;
+	unsigned int n = 0;
+	__s32 res;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		if (size == I2C_SMBUS_WORD_DATA)
+			res = i2c_smbus_read_word_data(file, command);
+		else
+			res = i2c_smbus_read_byte_data(file, command);
+		n++;
+		/* Only the end of the polling time is -ETIMEDOUT */
+		if (res == -ETIMEDOUT)
+			res = -EIO;
+		if (res < 0 || (res & mask) == match)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left = timeout_ms * 1000L
+		     - (now.tv_sec - start.tv_sec) * 1000000L
+		     - (now.tv_nsec - start.tv_nsec) / 1000;
+		if (left <= 0) {
+			res = -ETIMEDOUT;
+			break;
+		}
+		if (n < POLL_BACK_TO_BACK)
+			continue;
+
+		/* Always do a last poll right at the deadline */
+		if (left > interval)
+			left = interval;
+		delay.tv_sec = left / 1000000;
+		delay.tv_nsec = (left % 1000000) * 1000;
+		nanosleep(&delay, NULL);
+
+		if (interval < POLL_MAX_INTERVAL)
+			interval *= 2;
+	}
+
+	if (polls)
+		*polls = n;
+	return res;
+}
+
+/*
+ * Poll a register until the bits set in mask have the value match, or
+ * timeout_ms milliseconds have elapsed. Returns the last value read on
+ * success, -ETIMEDOUT on timeout, or another negative errno on read
+ * error. A bus timeout during a read is reported as -EIO, so that it
+ * isn't taken for the end of the polling time.
+ * If polls isn't NULL, the number of reads is stored there.
+ */
+__s32 i2c_smbus_poll_byte_data(int file, __u8 command, __u8 mask, __u8 match,
+			       unsigned int timeout_ms, unsigned int *polls)
+{
+	return i2c_smbus_poll(file, command, I2C_SMBUS_BYTE_DATA, mask, match,
+			      timeout_ms, polls);
+}
+
+__s32 i2c_smbus_poll_word_data(int file, __u8 command, __u16 mask,
+			       __u16 match, unsigned int timeout_ms,
+			       unsigned int *polls)
+{
+	return i2c_smbus_poll(file, command, I2C_SMBUS_WORD_DATA, mask, match,
+			      timeout_ms, polls);
+}
+
 __s32 i2c_smbus_process_call(int file, __u8 command, __u16 value)
 {
 	union i2c_smbus_data data;
@@ -0,0 +1,82 @@
+# Tests and benchmarks, on simulated i2c-dev buses
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+TEST_DIR	:= test
+
+TEST_CFLAGS	:= -Wstrict-prototypes -Wshadow -Wpointer-arith -Wcast-qual \
+		   -Wcast-align -Wwrite-strings -Wnested-externs -Winline \
+		   -W -Wundef -Wmissing-prototypes -Iinclude
+ifeq ($(USE_STATIC_LIB),1)
+TEST_LDFLAGS	:= $(LIB_DIR)/$(LIB_STLIBNAME)
+else
+TEST_LDFLAGS	:= -L$(LIB_DIR) -li2c
+endif
+TEST_LDFLAGS	+= -pthread
+
+TEST_TARGETS	:= fakei2c.so sched-test eeprom-test eeprom-bench
+
+# The programs run with the simulator preloaded and the library built
+TEST_RUN	:= LD_LIBRARY_PATH=$(LIB_DIR) \
+		   LD_PRELOAD=$(CURDIR)/$(TEST_DIR)/fakei2c.so
+
+#
+# Programs
+#
+
+$(TEST_DIR)/fakei2c.so: $(TEST_DIR)/fakei2c.c $(TEST_DIR)/fakei2c.h
+	$(CC) $(SOCFLAGS) -shared $(LDFLAGS) -o $@ $< -ldl -pthread
+
+$(TEST_DIR)/sched-test: $(TEST_DIR)/sched-test.o
+	$(CC) $(LDFLAGS) -o $@ $^ $(TEST_LDFLAGS)
+
+$(TEST_DIR)/eeprom-test: $(TEST_DIR)/eeprom-test.o
+	$(CC) $(LDFLAGS) -o $@ $^ $(TEST_LDFLAGS)
+
+$(TEST_DIR)/eeprom-bench: $(TEST_DIR)/eeprom-bench.o
+	$(CC) $(LDFLAGS) -o $@ $^ $(TEST_LDFLAGS)
+
+#
+# Objects
+#
+
+$(TEST_DIR)/sched-test.o: $(TEST_DIR)/sched-test.c $(TEST_DIR)/fakei2c.h $(INCLUDE_DIR)/i2c/sched.h \
+			  $(INCLUDE_DIR)/i2c/smbus.h
+	$(CC) $(CFLAGS) $(TEST_CFLAGS) -c $< -o $@
+
+$(TEST_DIR)/eeprom-test.o: $(TEST_DIR)/eeprom-test.c $(TEST_DIR)/fakei2c.h $(INCLUDE_DIR)/i2c/eeprom.h
+	$(CC) $(CFLAGS) $(TEST_CFLAGS) -c $< -o $@
+
+$(TEST_DIR)/eeprom-bench.o: $(TEST_DIR)/eeprom-bench.c $(TEST_DIR)/fakei2c.h $(INCLUDE_DIR)/i2c/eeprom.h
+	$(CC) $(CFLAGS) $(TEST_CFLAGS) -c $< -o $@
+
+#
+# Commands
+#
+
+all-test: $(addprefix $(TEST_DIR)/,$(TEST_TARGETS))
+
+check-test: all-lib $(addprefix $(TEST_DIR)/,$(TEST_TARGETS))
+	$(TEST_RUN) $(TEST_DIR)/sched-test
+	for funcs in i2c smbus byte ; do \
+	FAKEI2C_FUNCS=$$funcs $(TEST_RUN) $(TEST_DIR)/eeprom-test || exit 1 ; done
+
+# Byte writes of a 24C512 take minutes, leave them out
+bench-test: all-lib $(addprefix $(TEST_DIR)/,$(TEST_TARGETS))
+	FAKEI2C_FUNCS=i2c $(TEST_RUN) $(TEST_DIR)/eeprom-bench
+	FAKEI2C_FUNCS=smbus $(TEST_RUN) $(TEST_DIR)/eeprom-bench
+	FAKEI2C_FUNCS=byte $(TEST_RUN) $(TEST_DIR)/eeprom-bench 24c02 24c04
+
+clean-test:
+	$(RM) $(addprefix $(TEST_DIR)/,*.o $(TEST_TARGETS))
+
+all: all-test
+
+check: check-test
+
+bench: bench-test
+
+clean: clean-test
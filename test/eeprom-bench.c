@@ -0,0 +1,173 @@
+/*
+    eeprom-bench.c - Benchmark the EEPROM functions of libi2c
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+/*
+ * Writes the whole of each EEPROM of bus 0 of the simulator, then reads
+ * it back, and prints the throughput and the number of transfers of
+ * each. The adapter functionality is set with FAKEI2C_FUNCS, the bus
+ * speed with FAKEI2C_BYTE_US (default: 90, like 100 kHz) and the write
+ * cycle time with FAKEI2C_TWR_US.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <i2c/eeprom.h>
+#include "fakei2c.h"
+
+#define BUS		"/dev/i2c-0"
+#define BYTE_US		"90"
+
+static const struct {
+	const char *name;
+	int address;
+	struct i2c_eeprom_geometry geo;
+} parts[] = {
+	{ "24c02", 0x51, { 256, 8, 1, 0 } },
+	{ "24c04", 0x52, { 512, 16, 1, 0 } },
+	{ "24c512", 0x50, { 65536, 128, 2, 0 } },
+};
+#define NPARTS	(sizeof(parts) / sizeof(parts[0]))
+
+static void help(void)
+{
+	fprintf(stderr,
+		"Usage: eeprom-bench [PART]...\n"
+		"  PART is 24c02, 24c04 or 24c512 (default: all)\n");
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(int file, unsigned i)
+{
+	struct i2c_eeprom *ee;
+	struct i2c_eeprom_stats stats;
+	unsigned int size = parts[i].geo.size, k;
+	unsigned long wr_xfers, rd_xfers;
+	double start, wr_time, rd_time;
+	__u8 *wbuf, *rbuf;
+	int ret;
+
+	ee = i2c_eeprom_open(file, parts[i].address, &parts[i].geo);
+	if (!ee) {
+		fprintf(stderr, "Error: %s: %s\n", parts[i].name,
+			strerror(errno));
+		return -1;
+	}
+	wbuf = malloc(size);
+	rbuf = malloc(size);
+	if (!wbuf || !rbuf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (k = 0; k < size; k++)
+		wbuf[k] = rand();
+
+	wr_xfers = fakei2c_transfers;
+	start = now();
+	ret = i2c_eeprom_write(ee, 0, wbuf, size);
+	if (!ret)
+		ret = i2c_eeprom_sync(ee);
+	wr_time = now() - start;
+	wr_xfers = fakei2c_transfers - wr_xfers;
+	if (ret)
+		goto out;
+
+	rd_xfers = fakei2c_transfers;
+	start = now();
+	ret = i2c_eeprom_read(ee, 0, rbuf, size);
+	rd_time = now() - start;
+	rd_xfers = fakei2c_transfers - rd_xfers;
+	if (ret)
+		goto out;
+
+	i2c_eeprom_get_stats(ee, &stats);
+	printf("%-7s %6u %9.3f %9.0f %8lu %6lu %9.4f %9.0f %8lu%s\n",
+	       parts[i].name, size, wr_time, size / wr_time, wr_xfers,
+	       stats.write_cycles, rd_time, size / rd_time, rd_xfers,
+	       memcmp(wbuf, rbuf, size) ? "  MISMATCH" : "");
+	if (memcmp(wbuf, rbuf, size))
+		ret = -EIO;
+
+out:
+	if (ret < 0)
+		fprintf(stderr, "Error: %s: %s\n", parts[i].name,
+			strerror(-ret));
+	free(wbuf);
+	free(rbuf);
+	i2c_eeprom_close(ee);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *funcs;
+	unsigned i;
+	int file, j, failed = 0;
+
+	for (j = 1; j < argc; j++) {
+		for (i = 0; i < NPARTS; i++)
+			if (!strcmp(argv[j], parts[i].name))
+				break;
+		if (i == NPARTS) {
+			help();
+			exit(1);
+		}
+	}
+	if (!FAKEI2C_LOADED()) {
+		fprintf(stderr, "Error: Must be run with fakei2c.so "
+			"preloaded\n");
+		exit(1);
+	}
+	setenv("FAKEI2C_BYTE_US", BYTE_US, 0);
+
+	file = open(BUS, O_RDWR);
+	if (file < 0) {
+		perror(BUS);
+		exit(1);
+	}
+
+	/* Same data every run */
+	srand(1);
+	funcs = getenv("FAKEI2C_FUNCS");
+	printf("Adapter: %s, %s us per byte\n", funcs ? funcs : "i2c",
+	       getenv("FAKEI2C_BYTE_US"));
+	printf("%-7s %6s %9s %9s %8s %6s %9s %9s %8s\n", "Part", "Bytes",
+	       "Write (s)", "B/s", "Xfers", "Cycles", "Read (s)", "B/s",
+	       "Xfers");
+	for (i = 0; i < NPARTS; i++) {
+		for (j = 1; j < argc; j++)
+			if (!strcmp(argv[j], parts[i].name))
+				break;
+		if (argc > 1 && j == argc)
+			continue;
+		if (bench(file, i))
+			failed = 1;
+	}
+
+	close(file);
+	exit(failed);
+}
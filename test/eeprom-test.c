@@ -0,0 +1,208 @@
+/*
+    eeprom-test.c - Test the EEPROM functions of libi2c
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+/*
+ * Runs on bus 0 of the simulator, with the adapter functionality set
+ * by FAKEI2C_FUNCS. Reads and writes must give the same results with
+ * all of them, in particular across the 256-byte blocks of parts
+ * answering at several addresses, which SMBus I2C block reads can't
+ * cross.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <i2c/eeprom.h>
+#include "fakei2c.h"
+
+#define BUS		"/dev/i2c-0"
+
+static const struct i2c_eeprom_geometry geo_24c04 = { 512, 16, 1, 0 };
+static const struct i2c_eeprom_geometry geo_24c512 = { 65536, 128, 2, 0 };
+
+static int failed;
+
+static void check(int cond, const char *test, const char *what)
+{
+	if (cond)
+		return;
+	printf("FAIL %s: %s\n", test, what);
+	failed = 1;
+}
+
+static void fill(__u8 *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+}
+
+/* Read ranges around the block boundary of a 24C04 */
+static void test_blocks(int file)
+{
+	const char *t = "blocks";
+	static const unsigned int ranges[][2] = {
+		{ 0, 512 }, { 0xf0, 0x20 }, { 0xff, 2 }, { 0x100, 0x100 },
+		{ 0x1, 0x1fe }, { 0xe1, 0x3f }, { 0x1ff, 1 },
+	};
+	struct i2c_eeprom *ee;
+	__u8 data[512], buf[512];
+	unsigned i, off, len;
+
+	ee = i2c_eeprom_open(file, 0x52, &geo_24c04);
+	check(ee != NULL, t, "open failed");
+	if (!ee)
+		return;
+
+	fill(data, sizeof(data));
+	check(i2c_eeprom_write(ee, 0, data, sizeof(data)) == 0, t,
+	      "write failed");
+	for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		off = ranges[i][0];
+		len = ranges[i][1];
+		memset(buf, 0, len);
+		check(i2c_eeprom_read(ee, off, buf, len) == 0, t,
+		      "read failed");
+		check(!memcmp(buf, data + off, len), t, "bad data");
+	}
+
+	/* Writes crossing the boundary too */
+	fill(data + 0xf8, 0x10);
+	check(i2c_eeprom_write(ee, 0xf8, data + 0xf8, 0x10) == 0, t,
+	      "write failed");
+	check(i2c_eeprom_read(ee, 0, buf, sizeof(buf)) == 0, t,
+	      "read failed");
+	check(!memcmp(buf, data, sizeof(buf)), t, "bad data");
+
+	i2c_eeprom_close(ee);
+}
+
+/* Page boundaries of a part with 2 address bytes, and current address
+   reads */
+static void test_pages(int file)
+{
+	const char *t = "pages";
+	struct i2c_eeprom *ee;
+	__u8 data[300], buf[300];
+
+	ee = i2c_eeprom_open(file, 0x50, &geo_24c512);
+	check(ee != NULL, t, "open failed");
+	if (!ee)
+		return;
+
+	fill(data, sizeof(data));
+	check(i2c_eeprom_write(ee, 0x7fc3, data, sizeof(data)) == 0, t,
+	      "write failed");
+	check(i2c_eeprom_read(ee, 0x7fc3, buf, 100) == 0, t, "read failed");
+	check(i2c_eeprom_read_current(ee, buf + 100, 200) == 0, t,
+	      "current address read failed");
+	check(!memcmp(buf, data, sizeof(buf)), t, "bad data");
+
+	i2c_eeprom_close(ee);
+}
+
+/* The poll for the end of the write cycle reads a byte, which moves the
+   current address once */
+static void test_current(int file)
+{
+	const char *t = "current";
+	struct i2c_eeprom *ee;
+	__u8 data[32], buf[4];
+
+	ee = i2c_eeprom_open(file, 0x50, &geo_24c512);
+	check(ee != NULL, t, "open failed");
+	if (!ee)
+		return;
+
+	fill(data, sizeof(data));
+	check(i2c_eeprom_write(ee, 0x100, data, sizeof(data)) == 0, t,
+	      "write failed");
+	check(i2c_eeprom_write(ee, 0x100, data, 16) == 0, t, "write failed");
+	check(i2c_eeprom_read_current(ee, buf, sizeof(buf)) == 0, t,
+	      "current address read failed");
+	check(!memcmp(buf, data + 17, sizeof(buf)), t, "bad current address");
+
+	i2c_eeprom_close(ee);
+}
+
+/* Ranges out of the part */
+static void test_range(int file)
+{
+	const char *t = "range";
+	struct i2c_eeprom *ee;
+	__u8 buf[2];
+
+	ee = i2c_eeprom_open(file, 0x52, &geo_24c04);
+	check(ee != NULL, t, "open failed");
+	if (!ee)
+		return;
+
+	check(i2c_eeprom_read(ee, 0x1ff, buf, 2) == -EINVAL, t,
+	      "read past the end");
+	check(i2c_eeprom_write(ee, 0x200, buf, 1) == -EINVAL, t,
+	      "write past the end");
+	check(i2c_eeprom_read(ee, 0xffffffff, buf, 2) == -EINVAL, t,
+	      "offset wrapped around");
+
+	i2c_eeprom_close(ee);
+}
+
+static const struct {
+	const char *name;
+	void (*run)(int file);
+} tests[] = {
+	{ "blocks", test_blocks },
+	{ "pages", test_pages },
+	{ "current", test_current },
+	{ "range", test_range },
+};
+
+int main(void)
+{
+	const char *funcs;
+	unsigned i;
+	int file, was_failed;
+
+	if (!FAKEI2C_LOADED()) {
+		fprintf(stderr, "Error: Must be run with fakei2c.so "
+			"preloaded\n");
+		exit(1);
+	}
+
+	file = open(BUS, O_RDWR);
+	if (file < 0) {
+		perror(BUS);
+		exit(1);
+	}
+
+	srand(1);
+	funcs = getenv("FAKEI2C_FUNCS");
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		was_failed = failed;
+		failed = 0;
+		tests[i].run(file);
+		printf("%s %s (%s)\n", failed ? "FAIL" : "ok  ", tests[i].name,
+		       funcs ? funcs : "i2c");
+		failed |= was_failed;
+	}
+
+	close(file);
+	exit(failed);
+}
@@ -0,0 +1,657 @@
+/*
+    fakei2c.c - Simulated i2c-dev buses, to be preloaded with LD_PRELOAD
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+/*
+ * Opening /dev/i2c-N returns a file on which the i2c-dev ioctls, read()
+ * and write() are executed by this simulator instead of the kernel, so
+ * that the tools and libi2c can be tested and benchmarked without
+ * hardware. Every bus has the same chips:
+ *
+ *   0x48       a 256-register device, register N initially holds N
+ *   0x50       a 24C512: 64 KiB, 2 address bytes, 128-byte pages
+ *   0x51       a 24C02: 256 bytes, 8-byte pages
+ *   0x52-0x53  a 24C04: 512 bytes, 16-byte pages
+ *
+ * The EEPROMs don't acknowledge their addresses during their write
+ * cycles. SMBus transactions are translated into I2C messages like the
+ * kernel does for adapters without native SMBus support. The environment
+ * variables are read when the first bus is opened:
+ *
+ *   FAKEI2C_BUSES      bus numbers which exist (default: "0 1")
+ *   FAKEI2C_FUNCS      i2c (default), smbus (SMBus quick, byte, word and
+ *                      I2C block transactions only) or byte (SMBus quick,
+ *                      byte and word transactions only)
+ *   FAKEI2C_DELAY_US   time each transfer takes, in microseconds
+ *   FAKEI2C_BYTE_US    time each byte on the bus takes, in microseconds
+ *   FAKEI2C_TWR_US     write cycle time of the EEPROMs (default: 3000)
+ *   FAKEI2C_STATE      file holding the contents of the chips, so that
+ *                      they persist across processes (default: memory)
+ *   FAKEI2C_STATS      if set, print transfer counts on exit
+ *
+ * Transfers on the same bus are serialized, transfers on different buses
+ * run in parallel.
+ */
+
+#define _GNU_SOURCE
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "fakei2c.h"
+
+#define MAX_BUSES	16
+#define MAX_FILES	1024
+
+/* The SMBus transactions the simulator translates */
+#define FUNC_SMBUS	(I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_BYTE | \
+			 I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_WORD_DATA | \
+			 I2C_FUNC_SMBUS_I2C_BLOCK)
+
+struct chip {
+	int addr;
+	int naddr;		/* Consecutive addresses */
+	unsigned int size;	/* Whole chip */
+	int addr_len;		/* Memory address bytes */
+	unsigned int page;	/* Page writes wrap around within a page */
+	int eeprom;		/* Has write cycles */
+	unsigned int off;	/* Of its contents in struct bus_state */
+};
+
+static const struct chip chips[] = {
+	{ 0x48, 1, 256, 1, 256, 0, 0 },
+	{ 0x50, 1, 65536, 2, 128, 1, 256 },
+	{ 0x51, 1, 256, 1, 8, 1, 256 + 65536 },
+	{ 0x52, 2, 512, 1, 16, 1, 256 + 65536 + 256 },
+};
+#define NCHIPS		(sizeof(chips) / sizeof(chips[0]))
+#define MEM_SIZE	(256 + 65536 + 256 + 512)
+
+/* Shared between processes if FAKEI2C_STATE is set */
+struct bus_state {
+	__u8 mem[MEM_SIZE];
+	unsigned int ptr[NCHIPS];	/* Address counters */
+	struct timespec busy_until[NCHIPS];
+};
+
+struct bus {
+	int exists;
+	pthread_mutex_t lock;
+	struct bus_state *st;
+};
+
+struct file {
+	struct bus *bus;
+	int addr;
+};
+
+int fakei2c_loaded = 1;
+unsigned long fakei2c_transfers;
+
+static struct bus buses[MAX_BUSES];
+static struct file files[MAX_FILES];
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int initialized;
+static unsigned long funcs;
+static long delay_us, byte_us, twr_us = 3000;
+static unsigned long n_msgs, n_bytes;
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, unsigned long, ...);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+
+static void resolve(void)
+{
+	if (real_open)
+		return;
+	real_open = dlsym(RTLD_NEXT, "open");
+	real_close = dlsym(RTLD_NEXT, "close");
+	real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	real_read = dlsym(RTLD_NEXT, "read");
+	real_write = dlsym(RTLD_NEXT, "write");
+}
+
+static long env_long(const char *name, long def)
+{
+	const char *s = getenv(name);
+
+	return s ? strtol(s, NULL, 0) : def;
+}
+
+static void reset_state(struct bus_state *st)
+{
+	int i;
+
+	memset(st, 0, sizeof(*st));
+	memset(st->mem, 0xff, sizeof(st->mem));
+	for (i = 0; i < 256; i++)
+		st->mem[chips[0].off + i] = i;
+}
+
+static int init(void)
+{
+	const char *s, *path;
+	struct bus_state *st;
+	char *end;
+	long nr;
+	int fd, fresh = 1, i;
+
+	s = getenv("FAKEI2C_FUNCS");
+	if (!s || !strcmp(s, "i2c"))
+		funcs = I2C_FUNC_I2C | FUNC_SMBUS;
+	else if (!strcmp(s, "smbus"))
+		funcs = FUNC_SMBUS;
+	else if (!strcmp(s, "byte"))
+		funcs = I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_BYTE |
+			I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_WORD_DATA;
+	else
+		return -1;
+	delay_us = env_long("FAKEI2C_DELAY_US", 0);
+	byte_us = env_long("FAKEI2C_BYTE_US", 0);
+	twr_us = env_long("FAKEI2C_TWR_US", twr_us);
+
+	path = getenv("FAKEI2C_STATE");
+	if (path) {
+		fd = real_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return -1;
+		fresh = lseek(fd, 0, SEEK_END) == 0;
+		if (ftruncate(fd, MAX_BUSES * sizeof(*st)) < 0) {
+			real_close(fd);
+			return -1;
+		}
+		st = mmap(NULL, MAX_BUSES * sizeof(*st), PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, 0);
+		real_close(fd);
+	} else {
+		st = mmap(NULL, MAX_BUSES * sizeof(*st), PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (st == MAP_FAILED)
+		return -1;
+
+	s = getenv("FAKEI2C_BUSES");
+	if (!s)
+		s = "0 1";
+	for (;;) {
+		nr = strtol(s, &end, 10);
+		if (end == s)
+			break;
+		if (nr >= 0 && nr < MAX_BUSES)
+			buses[nr].exists = 1;
+		s = end;
+	}
+	for (i = 0; i < MAX_BUSES; i++) {
+		pthread_mutex_init(&buses[i].lock, NULL);
+		buses[i].st = &st[i];
+		if (fresh)
+			reset_state(&st[i]);
+	}
+
+	return 0;
+}
+
+static struct file *lookup(int fd)
+{
+	if (fd < 0 || fd >= MAX_FILES || !files[fd].bus)
+		return NULL;
+	return &files[fd];
+}
+
+static void wait_us(long us)
+{
+	struct timespec ts;
+
+	if (us <= 0)
+		return;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = us % 1000000 * 1000;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+static int before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* The chip answering at addr, which must acknowledge it */
+static int find_chip(struct bus *b, int addr)
+{
+	struct timespec now;
+	unsigned int i;
+
+	for (i = 0; i < NCHIPS; i++) {
+		if (addr < chips[i].addr || addr >= chips[i].addr + chips[i].naddr)
+			continue;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (before(&now, &b->st->busy_until[i]))
+			return -1;
+		return i;
+	}
+	return -1;
+}
+
+static int chip_write(struct bus *b, int addr, const __u8 *buf, unsigned len)
+{
+	const struct chip *c;
+	struct timespec *t;
+	unsigned int p, base, i;
+	int n;
+
+	n = find_chip(b, addr);
+	if (n < 0)
+		return -ENXIO;
+	c = &chips[n];
+	if (!len)
+		return 0;
+	if (len < (unsigned)c->addr_len) {
+		/* Only the high byte of the address */
+		b->st->ptr[n] = buf[0] << 8;
+		return 0;
+	}
+
+	/* Extra chip addresses select 256-byte blocks */
+	p = addr - c->addr;
+	for (i = 0; i < (unsigned)c->addr_len; i++)
+		p = (p << 8) | buf[i];
+	p %= c->size;
+	b->st->ptr[n] = p;
+	if (len == (unsigned)c->addr_len)
+		return 0;
+
+	base = p - p % c->page;
+	for (; i < len; i++) {
+		b->st->mem[c->off + p] = buf[i];
+		p = base + (p + 1 - base) % c->page;
+	}
+	b->st->ptr[n] = p;
+	if (c->eeprom) {
+		t = &b->st->busy_until[n];
+		clock_gettime(CLOCK_MONOTONIC, t);
+		t->tv_nsec += twr_us * 1000;
+		t->tv_sec += t->tv_nsec / 1000000000;
+		t->tv_nsec %= 1000000000;
+	}
+	return 0;
+}
+
+static int chip_read(struct bus *b, int addr, __u8 *buf, unsigned len)
+{
+	const struct chip *c;
+	unsigned int i;
+	int n;
+
+	n = find_chip(b, addr);
+	if (n < 0)
+		return -ENXIO;
+	c = &chips[n];
+	for (i = 0; i < len; i++) {
+		buf[i] = b->st->mem[c->off + b->st->ptr[n]];
+		b->st->ptr[n] = (b->st->ptr[n] + 1) % c->size;
+	}
+	return 0;
+}
+
+/* Execute messages with the bus lock held, returns 0 or a negative errno */
+static int transfer(struct bus *b, struct i2c_msg *msgs, unsigned nmsgs)
+{
+	unsigned int i;
+	long us = delay_us;
+	int ret = 0;
+
+	/* Transfers on other buses may be counted meanwhile */
+	__atomic_add_fetch(&fakei2c_transfers, 1, __ATOMIC_RELAXED);
+	for (i = 0; i < nmsgs && !ret; i++) {
+		__atomic_add_fetch(&n_msgs, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&n_bytes, 1 + msgs[i].len, __ATOMIC_RELAXED);
+		us += byte_us * (1 + msgs[i].len);
+		if (msgs[i].flags & I2C_M_RD)
+			ret = chip_read(b, msgs[i].addr, msgs[i].buf,
+					msgs[i].len);
+		else
+			ret = chip_write(b, msgs[i].addr, msgs[i].buf,
+					 msgs[i].len);
+	}
+	wait_us(us);
+
+	return ret;
+}
+
+static int do_rdwr(struct bus *b, struct i2c_rdwr_ioctl_data *rdwr)
+{
+	unsigned int i;
+	int ret;
+
+	if (!(funcs & I2C_FUNC_I2C))
+		return -EOPNOTSUPP;
+	if (rdwr->nmsgs > I2C_RDRW_IOCTL_MAX_MSGS)
+		return -EINVAL;
+	for (i = 0; i < rdwr->nmsgs; i++)
+		if (rdwr->msgs[i].len > 8192 ||
+		    (rdwr->msgs[i].flags & I2C_M_RECV_LEN))
+			return -EINVAL;
+
+	ret = transfer(b, rdwr->msgs, rdwr->nmsgs);
+	return ret < 0 ? ret : (int)rdwr->nmsgs;
+}
+
+static unsigned long smbus_func(int size, char read_write)
+{
+	int rd = read_write == I2C_SMBUS_READ;
+
+	switch (size) {
+	case I2C_SMBUS_QUICK:
+		return I2C_FUNC_SMBUS_QUICK;
+	case I2C_SMBUS_BYTE:
+		return rd ? I2C_FUNC_SMBUS_READ_BYTE :
+			    I2C_FUNC_SMBUS_WRITE_BYTE;
+	case I2C_SMBUS_BYTE_DATA:
+		return rd ? I2C_FUNC_SMBUS_READ_BYTE_DATA :
+			    I2C_FUNC_SMBUS_WRITE_BYTE_DATA;
+	case I2C_SMBUS_WORD_DATA:
+		return rd ? I2C_FUNC_SMBUS_READ_WORD_DATA :
+			    I2C_FUNC_SMBUS_WRITE_WORD_DATA;
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		return rd ? I2C_FUNC_SMBUS_READ_I2C_BLOCK :
+			    I2C_FUNC_SMBUS_WRITE_I2C_BLOCK;
+	default:
+		return 0;
+	}
+}
+
+/* Translate SMBus transactions into I2C messages */
+static int do_smbus(struct bus *b, int addr,
+		    struct i2c_smbus_ioctl_data *args)
+{
+	union i2c_smbus_data *data = args->data;
+	__u8 wbuf[I2C_SMBUS_BLOCK_MAX + 1], rbuf[I2C_SMBUS_BLOCK_MAX];
+	struct i2c_msg msgs[2] = {
+		{ .addr = addr, .flags = 0, .len = 1, .buf = wbuf },
+		{ .addr = addr, .flags = I2C_M_RD, .len = 0, .buf = rbuf },
+	};
+	int rd = args->read_write == I2C_SMBUS_READ, nmsgs = rd ? 2 : 1;
+	int size = args->size, ret;
+
+	/* Like i2c-dev, reads of this kind always ask for 32 bytes */
+	if (size == I2C_SMBUS_I2C_BLOCK_BROKEN) {
+		size = I2C_SMBUS_I2C_BLOCK_DATA;
+		if (rd)
+			data->block[0] = I2C_SMBUS_BLOCK_MAX;
+	}
+	if (!(funcs & smbus_func(size, args->read_write)))
+		return -EOPNOTSUPP;
+
+	wbuf[0] = args->command;
+	switch (size) {
+	case I2C_SMBUS_QUICK:
+		msgs[0].flags = rd ? I2C_M_RD : 0;
+		msgs[0].len = 0;
+		nmsgs = 1;
+		break;
+	case I2C_SMBUS_BYTE:
+		if (rd) {
+			msgs[0] = msgs[1];
+			msgs[0].len = 1;
+		}
+		nmsgs = 1;
+		break;
+	case I2C_SMBUS_BYTE_DATA:
+		if (rd)
+			msgs[1].len = 1;
+		else {
+			msgs[0].len = 2;
+			wbuf[1] = data->byte;
+		}
+		break;
+	case I2C_SMBUS_WORD_DATA:
+		if (rd)
+			msgs[1].len = 2;
+		else {
+			msgs[0].len = 3;
+			wbuf[1] = data->word & 0xff;
+			wbuf[2] = data->word >> 8;
+		}
+		break;
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		if (!data->block[0] || data->block[0] > I2C_SMBUS_BLOCK_MAX)
+			return -EINVAL;
+		if (rd)
+			msgs[1].len = data->block[0];
+		else {
+			msgs[0].len = data->block[0] + 1;
+			memcpy(wbuf + 1, data->block + 1, data->block[0]);
+		}
+		break;
+	}
+
+	ret = transfer(b, msgs, nmsgs);
+	if (ret < 0 || !rd)
+		return ret;
+
+	switch (size) {
+	case I2C_SMBUS_BYTE:
+		data->byte = rbuf[0];
+		break;
+	case I2C_SMBUS_BYTE_DATA:
+		data->byte = rbuf[0];
+		break;
+	case I2C_SMBUS_WORD_DATA:
+		data->word = rbuf[0] | (rbuf[1] << 8);
+		break;
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		memcpy(data->block + 1, rbuf, data->block[0]);
+		break;
+	}
+	return 0;
+}
+
+int open(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode = 0;
+	char *end;
+	long nr;
+	int fd;
+
+	resolve();
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (strncmp(path, "/dev/i2c-", 9))
+		return real_open(path, flags, mode);
+
+	pthread_mutex_lock(&init_lock);
+	if (!initialized && init() == 0)
+		initialized = 1;
+	pthread_mutex_unlock(&init_lock);
+	if (!initialized) {
+		errno = EIO;
+		return -1;
+	}
+
+	nr = strtol(path + 9, &end, 10);
+	if (end == path + 9 || *end || nr < 0 || nr >= MAX_BUSES ||
+	    !buses[nr].exists) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* Something real to poll, lock and close */
+	fd = real_open("/dev/null",
+		       (flags & (O_CLOEXEC | O_NONBLOCK)) | O_RDWR);
+	if (fd < 0)
+		return -1;
+	if (fd >= MAX_FILES) {
+		real_close(fd);
+		errno = EMFILE;
+		return -1;
+	}
+	files[fd].bus = &buses[nr];
+	files[fd].addr = -1;
+	return fd;
+}
+
+int open64(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode = 0;
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return open(path, flags, mode);
+}
+
+int close(int fd)
+{
+	resolve();
+	if (lookup(fd))
+		files[fd].bus = NULL;
+	return real_close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	struct file *f;
+	va_list ap;
+	void *arg;
+	int ret;
+
+	resolve();
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	f = lookup(fd);
+	if (!f)
+		return real_ioctl(fd, request, arg);
+
+	switch (request) {
+	case I2C_FUNCS:
+		*(unsigned long *)arg = funcs;
+		return 0;
+	case I2C_SLAVE:
+	case I2C_SLAVE_FORCE:
+		if ((unsigned long)arg > 0x7f) {
+			errno = EINVAL;
+			return -1;
+		}
+		f->addr = (unsigned long)arg;
+		return 0;
+	case I2C_PEC:
+	case I2C_TIMEOUT:
+	case I2C_RETRIES:
+		return 0;
+	case I2C_SMBUS:
+		pthread_mutex_lock(&f->bus->lock);
+		ret = do_smbus(f->bus, f->addr, arg);
+		pthread_mutex_unlock(&f->bus->lock);
+		break;
+	case I2C_RDWR:
+		pthread_mutex_lock(&f->bus->lock);
+		ret = do_rdwr(f->bus, arg);
+		pthread_mutex_unlock(&f->bus->lock);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+	return ret;
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+	struct i2c_msg msg;
+	struct file *f;
+	int ret;
+
+	resolve();
+	f = lookup(fd);
+	if (!f)
+		return real_read(fd, buf, count);
+	if (count > 8192) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	msg.addr = f->addr;
+	msg.flags = I2C_M_RD;
+	msg.len = count;
+	msg.buf = buf;
+	pthread_mutex_lock(&f->bus->lock);
+	ret = transfer(f->bus, &msg, 1);
+	pthread_mutex_unlock(&f->bus->lock);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+	return count;
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	struct i2c_msg msg;
+	struct file *f;
+	int ret;
+
+	resolve();
+	f = lookup(fd);
+	if (!f)
+		return real_write(fd, buf, count);
+	if (count > 8192) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	msg.addr = f->addr;
+	msg.flags = 0;
+	msg.len = count;
+	msg.buf = (__u8 *)buf;
+	pthread_mutex_lock(&f->bus->lock);
+	ret = transfer(f->bus, &msg, 1);
+	pthread_mutex_unlock(&f->bus->lock);
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+	return count;
+}
+
+static void __attribute__((destructor)) report(void)
+{
+	if (initialized && getenv("FAKEI2C_STATS"))
+		fprintf(stderr, "fakei2c: %lu transfers, %lu messages, "
+			"%lu bytes\n", fakei2c_transfers, n_msgs, n_bytes);
+}
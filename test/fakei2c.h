@@ -0,0 +1,28 @@
+/*
+    fakei2c.h - For the programs run on the simulated i2c-dev buses
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+#ifndef _FAKEI2C_H_
+#define _FAKEI2C_H_
+
+/* Defined by fakei2c.so, so that the test programs can make sure they
+   don't write to the chips of real buses */
+extern int fakei2c_loaded __attribute__((weak));
+
+#define FAKEI2C_LOADED()	(&fakei2c_loaded != 0)
+
+/* Transfers executed so far, on all buses */
+extern unsigned long fakei2c_transfers __attribute__((weak));
+
+#endif /* _FAKEI2C_H_ */
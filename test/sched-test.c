@@ -0,0 +1,291 @@
+/*
+    sched-test.c - Test the transaction scheduler of libi2c
+    Copyright (C) 2026  The i2c-tools authors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+/*
+ * Runs on bus 0 of the simulator, with a latency per transfer and per
+ * byte like a 100 kHz bus unless FAKEI2C_DELAY_US and FAKEI2C_BYTE_US
+ * say otherwise. Uses the register device at 0x48.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <i2c/sched.h>
+#include <i2c/smbus.h>
+#include "fakei2c.h"
+
+#define BUS		"/dev/i2c-0"
+#define CHIP		0x48
+#define DELAY_US	"200"
+#define BYTE_US		"90"
+
+/* Completion order */
+static struct i2c_sched_req *order[16];
+static int norder;
+static int failed;
+
+static void check(int cond, const char *test, const char *what)
+{
+	if (cond)
+		return;
+	printf("FAIL %s: %s\n", test, what);
+	failed = 1;
+}
+
+static long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void record(struct i2c_sched_req *req)
+{
+	if (norder < 16)
+		order[norder++] = req;
+	/* Completion time */
+	*(long long *)req->priv = now_us();
+}
+
+static void read_req(struct i2c_sched_req *req, int sched_class,
+		     unsigned deadline_us, union i2c_smbus_data *data,
+		     long long *done_us)
+{
+	memset(req, 0, sizeof(*req));
+	req->type = I2C_SCHED_SMBUS;
+	req->sched_class = sched_class;
+	req->deadline_us = deadline_us;
+	req->addr = CHIP;
+	req->read_write = I2C_SMBUS_READ;
+	req->command = 0x10;
+	req->size = I2C_SMBUS_BYTE_DATA;
+	req->data = data;
+	req->complete = record;
+	req->priv = done_us;
+}
+
+static void block_req(struct i2c_sched_req *req, int sched_class,
+		      __u8 *buf, unsigned len, long long *done_us)
+{
+	memset(req, 0, sizeof(*req));
+	req->type = I2C_SCHED_BLOCK_READ;
+	req->sched_class = sched_class;
+	req->addr = CHIP;
+	req->command = 0;
+	req->buf = buf;
+	req->len = len;
+	req->complete = record;
+	req->priv = done_us;
+}
+
+/* Classes first, then earliest deadline, then submission order */
+static void test_order(int file)
+{
+	const char *t = "order";
+	struct i2c_sched *s;
+	struct i2c_sched_req req[5];
+	union i2c_smbus_data data[5];
+	long long done[5];
+	__u8 buf[64];
+	int i;
+
+	s = i2c_sched_new(file, 0);
+	block_req(&req[0], I2C_SCHED_BULK, buf, sizeof(buf), &done[0]);
+	read_req(&req[1], I2C_SCHED_NORMAL, 0, &data[1], &done[1]);
+	read_req(&req[2], I2C_SCHED_NORMAL, 50000, &data[2], &done[2]);
+	read_req(&req[3], I2C_SCHED_NORMAL, 10000, &data[3], &done[3]);
+	read_req(&req[4], I2C_SCHED_URGENT, 0, &data[4], &done[4]);
+	norder = 0;
+	for (i = 0; i < 5; i++)
+		check(i2c_sched_submit(s, &req[i]) == 0, t, "submit failed");
+	while (i2c_sched_run(s, 0))
+		;
+
+	check(norder == 5, t, "not all completed");
+	check(order[0] == &req[4], t, "urgent not first");
+	check(order[1] == &req[3], t, "earliest deadline not second");
+	check(order[2] == &req[2], t, "later deadline not third");
+	check(order[3] == &req[1], t, "no deadline not after deadlines");
+	check(order[4] == &req[0], t, "bulk not last");
+	for (i = 1; i < 5; i++)
+		check(req[i].ret == 0 && data[i].byte == 0x10, t, "bad data");
+	check(req[0].ret == sizeof(buf), t, "bad block read length");
+	for (i = 0; i < (int)sizeof(buf); i++)
+		check(buf[i] == i, t, "bad block data");
+	i2c_sched_free(s);
+}
+
+/* An urgent transaction only waits for the current chunk of a long block
+   read */
+static void test_preempt(int file)
+{
+	const char *t = "preempt";
+	struct i2c_sched *s;
+	struct i2c_sched_req bulk, urgent;
+	union i2c_smbus_data data;
+	long long bulk_done = 0, urgent_done = 0, start, chunk_us;
+	__u8 buf[256];
+	int i;
+
+	/* Address, command, repeated start address and data bytes */
+	chunk_us = atol(getenv("FAKEI2C_DELAY_US")) +
+		   atol(getenv("FAKEI2C_BYTE_US")) * (3 + 32);
+
+	s = i2c_sched_new(file, 32);
+	check(i2c_sched_start(s) == 0, t, "start failed");
+	block_req(&bulk, I2C_SCHED_BULK, buf, sizeof(buf), &bulk_done);
+	check(i2c_sched_submit(s, &bulk) == 0, t, "bulk submit failed");
+	usleep(chunk_us * 3 / 2);
+
+	/* Twice a chunk and the transaction itself, plus slack */
+	read_req(&urgent, I2C_SCHED_URGENT, 4 * chunk_us + 5000, &data,
+		 &urgent_done);
+	start = now_us();
+	check(i2c_sched_submit(s, &urgent) == 0, t, "urgent submit failed");
+	check(i2c_sched_wait(s, &urgent) == 0, t, "urgent failed");
+	check(i2c_sched_wait(s, &bulk) == sizeof(buf), t, "bulk failed");
+
+	printf("     chunk %lld us, urgent latency %lld us, block read "
+	       "%lld us\n", chunk_us, urgent_done - start,
+	       bulk_done - start);
+	check(!urgent.missed, t, "urgent missed its deadline");
+	check(urgent_done < bulk_done, t, "urgent waited for the block read");
+	for (i = 0; i < (int)sizeof(buf); i++)
+		check(buf[i] == i, t, "bad block data");
+	i2c_sched_free(s);
+}
+
+/* Late transactions are executed and reported */
+static void test_missed(int file)
+{
+	const char *t = "missed";
+	struct i2c_sched *s;
+	struct i2c_sched_req req;
+	struct i2c_sched_stats stats;
+	union i2c_smbus_data data;
+	long long done;
+
+	s = i2c_sched_new(file, 0);
+	read_req(&req, I2C_SCHED_NORMAL, 100, &data, &done);
+	check(i2c_sched_submit(s, &req) == 0, t, "submit failed");
+	usleep(2000);
+	check(i2c_sched_wait(s, &req) == 0, t, "transaction failed");
+	check(req.missed && req.late_ns >= 1900000, t, "miss not reported");
+
+	i2c_sched_get_stats(s, &stats);
+	check(stats.completed[I2C_SCHED_NORMAL] == 1 &&
+	      stats.missed[I2C_SCHED_NORMAL] == 1 &&
+	      stats.max_late_ns[I2C_SCHED_NORMAL] == req.late_ns, t,
+	      "bad statistics");
+	i2c_sched_free(s);
+}
+
+/* A queued request can't be submitted again, and stays untouched */
+static void test_resubmit(int file)
+{
+	const char *t = "resubmit";
+	struct i2c_sched *s;
+	struct i2c_sched_req req;
+	struct i2c_sched_stats stats;
+	long long done;
+	__u8 buf[96];
+	int i, chunks;
+
+	s = i2c_sched_new(file, 32);
+	block_req(&req, I2C_SCHED_NORMAL, buf, sizeof(buf), &done);
+	check(i2c_sched_submit(s, &req) == 0, t, "submit failed");
+	check(i2c_sched_run(s, 0) == 1, t, "nothing run");
+	check(i2c_sched_submit(s, &req) == -EBUSY, t, "resubmitted");
+	for (chunks = 1; i2c_sched_run(s, 0); chunks++)
+		;
+	check(chunks == 3, t, "block read restarted");
+	check(req.ret == sizeof(buf), t, "bad block read length");
+	for (i = 0; i < (int)sizeof(buf); i++)
+		check(buf[i] == i, t, "bad block data");
+
+	i2c_sched_get_stats(s, &stats);
+	check(stats.completed[I2C_SCHED_NORMAL] == 1, t, "bad statistics");
+	i2c_sched_free(s);
+}
+
+/* Pending transactions are cancelled when the scheduler is freed */
+static void test_cancel(int file)
+{
+	const char *t = "cancel";
+	struct i2c_sched *s;
+	struct i2c_sched_req req[3];
+	union i2c_smbus_data data[3];
+	long long done[3];
+	int i;
+
+	s = i2c_sched_new(file, 0);
+	norder = 0;
+	for (i = 0; i < 3; i++) {
+		read_req(&req[i], i, 0, &data[i], &done[i]);
+		check(i2c_sched_submit(s, &req[i]) == 0, t, "submit failed");
+	}
+	i2c_sched_free(s);
+
+	check(norder == 3, t, "not all completed");
+	for (i = 0; i < 3; i++)
+		check(req[i].ret == -ECANCELED, t, "not cancelled");
+}
+
+static const struct {
+	const char *name;
+	void (*run)(int file);
+} tests[] = {
+	{ "order", test_order },
+	{ "preempt", test_preempt },
+	{ "missed", test_missed },
+	{ "resubmit", test_resubmit },
+	{ "cancel", test_cancel },
+};
+
+int main(void)
+{
+	unsigned i;
+	int file, was_failed;
+
+	if (!FAKEI2C_LOADED()) {
+		fprintf(stderr, "Error: Must be run with fakei2c.so "
+			"preloaded\n");
+		exit(1);
+	}
+	setenv("FAKEI2C_DELAY_US", DELAY_US, 0);
+	setenv("FAKEI2C_BYTE_US", BYTE_US, 0);
+
+	file = open(BUS, O_RDWR);
+	if (file < 0) {
+		perror(BUS);
+		exit(1);
+	}
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		was_failed = failed;
+		failed = 0;
+		tests[i].run(file);
+		printf("%s %s\n", failed ? "FAIL" : "ok  ", tests[i].name);
+		failed |= was_failed;
+	}
+
+	close(file);
+	exit(failed);
+}
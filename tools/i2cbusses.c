@@ -42,6 +42,8 @@
 #include "i2cbusses.h"
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <i2c/lock.h>
+#include <i2c/remote.h>
 
 enum adt { adt_dummy, adt_isa, adt_i2c, adt_smbus, adt_unknown };
 
@@ -74,7 +76,7 @@ static enum adt i2c_get_funcs(int i2cbus)
 	if (file < 0)
 		return adt_unknown;
 
-	if (ioctl(file, I2C_FUNCS, &funcs) < 0)
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0)
 		ret = adt_unknown;
 	else if (funcs & I2C_FUNC_I2C)
 		ret = adt_i2c;
@@ -403,11 +405,33 @@ int open_i2c_dev(int i2cbus, char *filename, size_t size, int quiet)
 	return file;
 }
 
+/*
+ * Open bus i2cbus through the i2cd daemon listening on socket_path, or
+ * directly if socket_path is NULL.
+ */
+int open_i2c_dev_via(const char *socket_path, int i2cbus, char *filename,
+		     size_t size, int quiet)
+{
+	int file;
+
+	if (!socket_path)
+		return open_i2c_dev(i2cbus, filename, size, quiet);
+
+	snprintf(filename, size, "i2cd:%d", i2cbus);
+	filename[size - 1] = '\0';
+	file = i2c_remote_open(socket_path, i2cbus);
+	if (file < 0 && !quiet)
+		fprintf(stderr, "Error: Could not open bus %d through `%s': %s\n",
+			i2cbus, socket_path, strerror(errno));
+
+	return file;
+}
+
 int set_slave_addr(int file, int address, int force)
 {
 	/* With force, let the user read from/write to the registers
 	   even when a driver is also running */
-	if (ioctl(file, force ? I2C_SLAVE_FORCE : I2C_SLAVE, address) < 0) {
+	if (i2c_ioctl(file, force ? I2C_SLAVE_FORCE : I2C_SLAVE, address) < 0) {
 		fprintf(stderr,
 			"Error: Could not set address to 0x%02x: %s\n",
 			address, strerror(errno));
@@ -416,3 +440,25 @@ int set_slave_addr(int file, int address, int force)
 
 	return 0;
 }
+
+/*
+ * Lock the chip during a multi-transaction sequence. A busy chip is an
+ * error, but a missing lock directory or the like is not worth failing
+ * for, the user gets a warning and *lock is set to -1.
+ */
+int lock_chip(int i2cbus, int address, int *lock)
+{
+	*lock = i2c_lock_chip(i2cbus, address, LOCK_TIMEOUT);
+	if (*lock == -ETIMEDOUT) {
+		fprintf(stderr, "Error: Chip 0x%02x on bus %d is busy\n",
+			address, i2cbus);
+		return -1;
+	}
+	if (*lock < 0) {
+		fprintf(stderr, "Warning: Could not lock chip 0x%02x: %s\n",
+			address, strerror(-*lock));
+		*lock = -1;
+	}
+
+	return 0;
+}
@@ -37,8 +37,17 @@ void free_adapters(struct i2c_adap *adapters);
 int lookup_i2c_bus(const char *i2cbus_arg);
 int parse_i2c_address(const char *address_arg);
 int open_i2c_dev(int i2cbus, char *filename, size_t size, int quiet);
+int open_i2c_dev_via(const char *socket_path, int i2cbus, char *filename,
+		     size_t size, int quiet);
 int set_slave_addr(int file, int address, int force);
+int lock_chip(int i2cbus, int address, int *lock);
+
+/* How long to wait for a chip locked by another process, in ms */
+#define LOCK_TIMEOUT		5000
 
 #define MISSING_FUNC_FMT	"Error: Adapter does not have %s capability\n"
 
+/* Largest message length accepted by i2c-dev in an I2C_RDWR transfer */
+#define I2C_DEV_MSG_MAX		8192
+
 #endif
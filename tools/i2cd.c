@@ -0,0 +1,985 @@
+/*
+    i2cd.c - A daemon serving I2C and SMBus transactions over a Unix socket
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+*/
+
+/*
+ * Each bus has a worker thread, which executes the requests of the
+ * clients of the bus one at a time, in the order they arrive. The main
+ * thread only does the socket I/O: it hands a client over to the worker
+ * of its bus once a request is complete, or its ring doorbell rang, and
+ * stops polling it until the worker is done with it. A slow transfer on
+ * one bus doesn't delay the clients of the other buses.
+ */
+
+/* For accept4 and F_GET_SEALS */
+#define _GNU_SOURCE 1
+
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <i2c/remote.h>
+#include <i2c/smbus.h>
+#include "i2cbusses.h"
+#include "../version.h"
+
+#define MAX_CLIENTS	64
+#define MAX_FDS		3	/* Passed with a request */
+#define LOCK_RETRY_MS	10	/* While a local user holds a bus lock */
+
+struct client;
+
+struct bus {
+	int nr;
+	int file;
+	int addr, force, pec;	/* Current settings of file, -1 if unknown */
+	__u8 *reply;		/* Replies are built here, one at a time */
+	pthread_t worker;
+
+	/* Protects the fields below */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/* Signaled when there is work to do */
+	struct client *queue;	/* Clients handed over to the worker */
+	struct client *owner;	/* Client holding the bus lock */
+	struct bus *next;
+};
+
+struct client {
+	int fd;
+	struct bus *bus;
+	int addr, force, pec;
+	struct i2cd_request req;
+	size_t got;		/* Bytes of the request received so far */
+	int ready;		/* Request complete, waiting to be served */
+	int busy;		/* Handed over to the bus worker */
+	int dead;		/* Found misbehaving by the bus worker */
+	int lock_busy;		/* Lock request waiting for a local user */
+	long long lock_retry;	/* When to try again, in ms */
+	struct client *next;	/* In the bus queue or the done list */
+	__u8 *payload;
+	size_t payload_size;
+	int fds[MAX_FDS];	/* Received with the request */
+	int nfds;
+
+	/* Reply not sent yet, requests aren't received meanwhile */
+	__u8 *out;
+	size_t out_size, out_len, out_sent;
+
+	/* Ring mode, see i2c_ring_open() */
+	void *ring;
+	size_t ring_size;
+	__u8 *ring_payload;	/* Private copy of the current slot */
+	unsigned entries, slot_size;
+	int sq_fd, cq_fd;
+	int ring_pending;	/* Doorbell rung while locked out */
+};
+
+static struct bus *buses;
+static struct client *clients[MAX_CLIENTS];
+static int nclients;
+static volatile sig_atomic_t stop;
+
+/* Clients the bus workers are done with, the eventfd wakes up the main
+   thread */
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct client *done_list;
+static int done_fd;
+
+static void help(void)
+{
+	fprintf(stderr,
+		"Usage: i2cd [-s SOCKET]\n"
+		"       i2cd -V\n"
+		"  SOCKET is the path of the Unix socket to listen on\n"
+		"    (default " I2CD_SOCKET ")\n");
+}
+
+static void handle_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void *bus_worker(void *arg);
+
+static struct bus *get_bus(int nr, int *err)
+{
+	char filename[20];
+	pthread_condattr_t attr;
+	struct bus *b;
+
+	for (b = buses; b; b = b->next)
+		if (b->nr == nr)
+			return b;
+
+	b = calloc(1, sizeof(*b));
+	if (!b || !(b->reply = malloc(I2CD_MAX_PAYLOAD))) {
+		*err = -ENOMEM;
+		goto fail;
+	}
+	b->file = open_i2c_dev(nr, filename, sizeof(filename), 1);
+	if (b->file < 0) {
+		*err = -errno;
+		goto fail;
+	}
+	b->nr = nr;
+	b->addr = b->force = b->pec = -1;
+
+	/* Lock retries are timed with the monotonic clock */
+	pthread_mutex_init(&b->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&b->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	*err = -pthread_create(&b->worker, NULL, bus_worker, b);
+	if (*err) {
+		close(b->file);
+		goto fail;
+	}
+	pthread_detach(b->worker);
+
+	b->next = buses;
+	buses = b;
+
+	return b;
+
+fail:
+	if (b)
+		free(b->reply);
+	free(b);
+	return NULL;
+}
+
+/* Set up the bus device file for the next SMBus transaction */
+static int select_chip(struct bus *b, int addr, int force, int pec)
+{
+	if (addr < 0)
+		return -EDESTADDRREQ;
+
+	if (b->addr != addr || b->force != force) {
+		if (i2c_ioctl(b->file, force ? I2C_SLAVE_FORCE : I2C_SLAVE,
+			      addr) < 0) {
+			b->addr = -1;
+			return -errno;
+		}
+		b->addr = addr;
+		b->force = force;
+	}
+
+	if (b->pec != pec) {
+		if (i2c_ioctl(b->file, I2C_PEC, pec) < 0) {
+			b->pec = -1;
+			return -errno;
+		}
+		b->pec = pec;
+	}
+
+	return 0;
+}
+
+static int select_client(struct client *c)
+{
+	return select_chip(c->bus, c->addr, c->force, c->pec);
+}
+
+/* The chip must have been selected already */
+static int do_smbus(struct bus *b, __u8 *payload, size_t plen, size_t *len)
+{
+	struct i2cd_smbus *smbus = (struct i2cd_smbus *)payload;
+	int ret;
+
+	if (plen != sizeof(*smbus))
+		return -EINVAL;
+
+	ret = i2c_smbus_access(b->file, smbus->read_write, smbus->command,
+			       smbus->size, &smbus->data);
+	if (ret < 0)
+		return ret;
+
+	memcpy(b->reply, smbus, sizeof(*smbus));
+	*len = sizeof(*smbus);
+	return 0;
+}
+
+static int do_rdwr(struct bus *b, size_t nmsgs, __u8 *payload, size_t plen,
+		   size_t *len)
+{
+	struct i2c_msg msgs[I2C_RDRW_IOCTL_MAX_MSGS];
+	struct i2c_rdwr_ioctl_data rdwr;
+	struct i2cd_msg *m = (struct i2cd_msg *)payload;
+	size_t wr = nmsgs * sizeof(*m), rd = 0;
+	unsigned i;
+	int ret;
+
+	if (!nmsgs || nmsgs > I2C_RDRW_IOCTL_MAX_MSGS || wr > plen)
+		return -EINVAL;
+
+	for (i = 0; i < nmsgs; i++) {
+		if (m[i].flags & I2C_M_RECV_LEN)
+			return -EOPNOTSUPP;
+
+		msgs[i].addr = m[i].addr;
+		msgs[i].flags = m[i].flags;
+		msgs[i].len = m[i].len;
+		if (m[i].flags & I2C_M_RD) {
+			if (rd + m[i].len > I2CD_MAX_PAYLOAD)
+				return -EINVAL;
+			msgs[i].buf = b->reply + rd;
+			rd += m[i].len;
+		} else {
+			if (wr + m[i].len > plen)
+				return -EINVAL;
+			msgs[i].buf = payload + wr;
+			wr += m[i].len;
+		}
+	}
+	if (wr != plen)
+		return -EINVAL;
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = nmsgs;
+	ret = i2c_ioctl(b->file, I2C_RDWR, &rdwr);
+	if (ret < 0)
+		return -errno;
+
+	*len = rd;
+	return ret;
+}
+
+static int do_lock(struct client *c)
+{
+	struct bus *b = c->bus;
+	int ret = 0;
+
+	c->lock_busy = 0;
+	pthread_mutex_lock(&b->lock);
+	switch (c->req.arg) {
+	case LOCK_EX:
+		/* Also keep out local users of the bus, without blocking the
+		   other clients until they are done */
+		if (b->owner != c && flock(b->file, LOCK_EX | LOCK_NB) < 0) {
+			if (errno != EWOULDBLOCK)
+				ret = -errno;
+			else
+				c->lock_busy = 1;
+			break;
+		}
+		b->owner = c;
+		break;
+	case LOCK_UN:
+		if (b->owner == c) {
+			flock(b->file, LOCK_UN);
+			b->owner = NULL;
+		}
+		break;
+	default:
+		ret = -EINVAL;
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	return ret;
+}
+
+static int do_ring(struct client *c)
+{
+	unsigned entries = c->req.arg, slot_size;
+	struct stat st;
+	size_t size;
+	int seals, err;
+	void *p;
+
+	if (c->ring)
+		return -EBUSY;
+	if (c->req.len != sizeof(__u32) || c->nfds != 3)
+		return -EINVAL;
+	memcpy(&slot_size, c->payload, sizeof(__u32));
+
+	/* Slots hold struct i2cd_smbus or struct i2cd_msg, keep them
+	   aligned */
+	if (!entries || entries > I2C_RING_MAX_ENTRIES ||
+	    (entries & (entries - 1)) || slot_size < sizeof(struct i2cd_smbus) ||
+	    slot_size > I2CD_MAX_PAYLOAD || slot_size % 8)
+		return -EINVAL;
+	size = I2C_RING_SIZE(entries, slot_size);
+
+	/* The client must not be able to shrink the memory under our feet */
+	seals = fcntl(c->fds[0], F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK) ||
+	    fstat(c->fds[0], &st) < 0 || (size_t)st.st_size < size)
+		return -EINVAL;
+
+	/* Never block on the doorbells */
+	if (fcntl(c->fds[1], F_SETFL, O_NONBLOCK) < 0 ||
+	    fcntl(c->fds[2], F_SETFL, O_NONBLOCK) < 0)
+		return -errno;
+
+	c->ring_payload = malloc(slot_size);
+	if (!c->ring_payload)
+		return -ENOMEM;
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fds[0], 0);
+	if (p == MAP_FAILED) {
+		err = -errno;
+		free(c->ring_payload);
+		c->ring_payload = NULL;
+		return err;
+	}
+
+	close(c->fds[0]);
+	c->ring = p;
+	c->ring_size = size;
+	c->entries = entries;
+	c->slot_size = slot_size;
+	c->sq_fd = c->fds[1];
+	c->cq_fd = c->fds[2];
+	c->nfds = 0;
+
+	return 0;
+}
+
+/* Execute the client's request, returns the reply ret value */
+static int execute(struct client *c, size_t *len)
+{
+	__u64 funcs;
+	unsigned long f;
+	int err = 0;
+
+	*len = 0;
+
+	if (c->req.op == I2CD_OPEN) {
+		if (c->bus)
+			return -EBUSY;
+		c->bus = get_bus(c->req.arg, &err);
+		return err;
+	}
+	if (!c->bus)
+		return -EBADF;
+
+	switch (c->req.op) {
+	case I2CD_FUNCS:
+		if (i2c_ioctl(c->bus->file, I2C_FUNCS, &f) < 0)
+			return -errno;
+		funcs = f;
+		memcpy(c->bus->reply, &funcs, sizeof(funcs));
+		*len = sizeof(funcs);
+		return 0;
+	case I2CD_SLAVE:
+	case I2CD_SLAVE_FORCE:
+		/* Check the address right away, like i2c-dev does */
+		c->force = c->req.op == I2CD_SLAVE_FORCE;
+		c->addr = c->req.arg;
+		err = select_client(c);
+		if (err < 0)
+			c->addr = -1;
+		return err;
+	case I2CD_PEC:
+		c->pec = !!c->req.arg;
+		return 0;
+	case I2CD_SMBUS:
+		err = select_client(c);
+		if (err < 0)
+			return err;
+		return do_smbus(c->bus, c->payload, c->req.len, len);
+	case I2CD_RDWR:
+		return do_rdwr(c->bus, c->req.arg, c->payload, c->req.len, len);
+	case I2CD_LOCK:
+		return do_lock(c);
+	case I2CD_RING:
+		return do_ring(c);
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Another client holds the lock of the bus, called with the bus lock
+   held */
+static int locked_out(const struct client *c)
+{
+	return c->bus->owner && c->bus->owner != c;
+}
+
+/*
+ * Execute all the transactions submitted through the client's ring. The
+ * submission entries and payloads are copied before being checked, as
+ * the client can change them at any time. Returns -1 if the client is
+ * misbehaving.
+ */
+static int ring_process(struct client *c)
+{
+	struct i2c_ring_index *sq = c->ring, *cq = sq + 1;
+	struct i2c_ring_sqe *sqes = (struct i2c_ring_sqe *)(cq + 1), sqe;
+	struct i2c_ring_cqe *cqes = (struct i2c_ring_cqe *)(sqes + c->entries);
+	__u8 *slots = (__u8 *)(cqes + c->entries), *slot;
+	__u32 mask = c->entries - 1, head, tail, cq_tail;
+	struct i2c_ring_cqe *cqe;
+	eventfd_t count;
+	size_t len;
+	int ret, done = 0;
+
+	eventfd_read(c->sq_fd, &count);
+	c->ring_pending = 0;
+
+	head = sq->head;
+	cq_tail = cq->tail;
+	tail = __atomic_load_n(&sq->tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		/* The client never has more than entries in flight */
+		if (tail - head > c->entries ||
+		    cq_tail - __atomic_load_n(&cq->head, __ATOMIC_ACQUIRE) >=
+		    c->entries)
+			return -1;
+
+		sqe = sqes[head & mask];
+		if (sqe.slot >= c->entries || sqe.len > c->slot_size) {
+			ret = -EINVAL;
+			goto complete;
+		}
+		slot = slots + (size_t)sqe.slot * c->slot_size;
+		memcpy(c->ring_payload, slot, sqe.len);
+
+		len = 0;
+		switch (sqe.op) {
+		case I2CD_SMBUS:
+			ret = select_chip(c->bus, sqe.addr,
+					  !!(sqe.flags & I2C_RING_FORCE),
+					  !!(sqe.flags & I2C_RING_PEC));
+			if (ret >= 0)
+				ret = do_smbus(c->bus, c->ring_payload,
+					       sqe.len, &len);
+			break;
+		case I2CD_RDWR:
+			ret = do_rdwr(c->bus, sqe.nmsgs, c->ring_payload,
+				      sqe.len, &len);
+			break;
+		default:
+			ret = -EINVAL;
+		}
+		if (len > c->slot_size)
+			ret = -EMSGSIZE;
+		else if (ret >= 0)
+			memcpy(slot, c->bus->reply, len);
+
+	complete:
+		cqe = &cqes[cq_tail & mask];
+		cqe->user_data = sqe.user_data;
+		cqe->ret = ret;
+		cqe->slot = sqe.slot;
+		__atomic_store_n(&cq->tail, ++cq_tail, __ATOMIC_RELEASE);
+		__atomic_store_n(&sq->head, ++head, __ATOMIC_RELEASE);
+		done = 1;
+
+		if (head == tail)
+			tail = __atomic_load_n(&sq->tail, __ATOMIC_ACQUIRE);
+	}
+
+	/* One doorbell for the whole batch */
+	if (done)
+		eventfd_write(c->cq_fd, 1);
+
+	return 0;
+}
+
+static void close_fds(struct client *c)
+{
+	while (c->nfds)
+		close(c->fds[--c->nfds]);
+}
+
+/*
+ * Receive as much of the current request as is available.
+ * Returns 1 if the request is complete, 0 if more data is needed, -1 if
+ * the client is gone or misbehaving.
+ */
+static int receive(struct client *c)
+{
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t ret;
+	size_t nfds, n;
+	int fd;
+
+	for (;;) {
+		if (c->got < sizeof(c->req)) {
+			iov.iov_base = (char *)&c->req + c->got;
+			iov.iov_len = sizeof(c->req) - c->got;
+		} else {
+			iov.iov_base = c->payload + (c->got - sizeof(c->req));
+			iov.iov_len = sizeof(c->req) + c->req.len - c->got;
+		}
+		if (!iov.iov_len)
+			return 1;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		ret = recvmsg(c->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+			return 0;
+		if (ret <= 0)
+			return -1;
+		c->got += ret;
+
+		/* Keep the passed file descriptors for execute() */
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET ||
+			    cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (n = 0; n < nfds; n++) {
+				memcpy(&fd, CMSG_DATA(cmsg) + n * sizeof(int),
+				       sizeof(int));
+				if (c->nfds < MAX_FDS)
+					c->fds[c->nfds++] = fd;
+				else
+					close(fd);
+			}
+		}
+		if (msg.msg_flags & MSG_CTRUNC)
+			return -1;
+
+		if (c->got == sizeof(c->req) && c->req.len > c->payload_size) {
+			if (c->req.len > I2CD_MAX_PAYLOAD)
+				return -1;
+			free(c->payload);
+			c->payload = malloc(c->req.len);
+			if (!c->payload)
+				return -1;
+			c->payload_size = c->req.len;
+		}
+	}
+}
+
+/* Send as much of the pending reply as the socket takes. Returns -1 if
+   the client is gone. */
+static int flush_reply(struct client *c)
+{
+	ssize_t ret;
+
+	while (c->out_sent < c->out_len) {
+		ret = send(c->fd, c->out + c->out_sent,
+			   c->out_len - c->out_sent, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EAGAIN)
+			return 0;	/* Polled for POLLOUT */
+		if (ret < 0)
+			return -1;
+		c->out_sent += ret;
+	}
+	c->out_len = c->out_sent = 0;
+
+	return 0;
+}
+
+static int serve(struct client *c)
+{
+	struct i2cd_reply rep;
+	size_t len;
+	__u8 *p;
+
+	rep.ret = execute(c, &len);
+	if (c->lock_busy)
+		return 0;	/* Retried by the bus worker */
+	rep.len = len;
+	c->got = 0;
+	c->ready = 0;
+	close_fds(c);
+
+	/* Queue the reply, the main thread sends it, and a client which
+	   doesn't read it must not block the others */
+	if (c->out_size < sizeof(rep) + len) {
+		p = realloc(c->out, sizeof(rep) + len);
+		if (!p)
+			return -1;
+		c->out = p;
+		c->out_size = sizeof(rep) + len;
+	}
+	memcpy(c->out, &rep, sizeof(rep));
+	if (len)
+		memcpy(c->out + sizeof(rep), c->bus->reply, len);
+	c->out_len = sizeof(rep) + len;
+	c->out_sent = 0;
+
+	return 0;
+}
+
+/*
+ * First client of the queue which can be served, taken out of the queue.
+ * If there is none, *retry is set to the time of the next lock retry, or
+ * 0. Called with the bus lock held.
+ */
+static struct client *next_job(struct bus *b, long long *retry)
+{
+	struct client **p, *c;
+	long long now = now_ms();
+
+	*retry = 0;
+	for (p = &b->queue; (c = *p); p = &c->next) {
+		if (locked_out(c))
+			continue;
+		if (c->lock_busy && c->lock_retry > now) {
+			if (!*retry || c->lock_retry < *retry)
+				*retry = c->lock_retry;
+			continue;
+		}
+		*p = c->next;
+		return c;
+	}
+
+	return NULL;
+}
+
+/* Give the client back to the main thread */
+static void job_done(struct client *c)
+{
+	pthread_mutex_lock(&done_lock);
+	c->next = done_list;
+	done_list = c;
+	pthread_mutex_unlock(&done_lock);
+	eventfd_write(done_fd, 1);
+}
+
+static void *bus_worker(void *arg)
+{
+	struct bus *b = arg;
+	struct client *c;
+	struct timespec ts;
+	long long retry;
+
+	pthread_mutex_lock(&b->lock);
+	for (;;) {
+		c = next_job(b, &retry);
+		if (!c) {
+			if (!retry) {
+				pthread_cond_wait(&b->cond, &b->lock);
+				continue;
+			}
+			ts.tv_sec = retry / 1000;
+			ts.tv_nsec = retry % 1000 * 1000000;
+			pthread_cond_timedwait(&b->cond, &b->lock, &ts);
+			continue;
+		}
+		pthread_mutex_unlock(&b->lock);
+
+		/* The request first, ring transactions come after it */
+		if (c->ready && serve(c) < 0)
+			c->dead = 1;
+		if (!c->dead && !c->lock_busy && c->ring_pending &&
+		    ring_process(c) < 0)
+			c->dead = 1;
+
+		pthread_mutex_lock(&b->lock);
+		if (c->lock_busy && !c->dead) {
+			/* Stays first in line */
+			c->lock_retry = now_ms() + LOCK_RETRY_MS;
+			c->next = b->queue;
+			b->queue = c;
+			continue;
+		}
+		job_done(c);
+	}
+
+	return NULL;
+}
+
+/* Hand the client over to the worker of its bus */
+static void queue_job(struct client *c)
+{
+	struct bus *b = c->bus;
+	struct client **p;
+
+	c->busy = 1;
+	c->next = NULL;
+	pthread_mutex_lock(&b->lock);
+	for (p = &b->queue; *p; p = &(*p)->next)
+		;
+	*p = c;
+	pthread_cond_signal(&b->cond);
+	pthread_mutex_unlock(&b->lock);
+}
+
+/* Never called while the client is busy */
+static void drop_client(struct client *c)
+{
+	struct bus *b = c->bus;
+
+	if (b) {
+		pthread_mutex_lock(&b->lock);
+		if (b->owner == c) {
+			flock(b->file, LOCK_UN);
+			b->owner = NULL;
+			pthread_cond_signal(&b->cond);
+		}
+		pthread_mutex_unlock(&b->lock);
+	}
+	if (c->ring) {
+		munmap(c->ring, c->ring_size);
+		free(c->ring_payload);
+		close(c->sq_fd);
+		close(c->cq_fd);
+	}
+	close_fds(c);
+	close(c->fd);
+	free(c->payload);
+	free(c->out);
+	c->fd = -1;
+}
+
+static int listen_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Error: Socket path too long\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		fprintf(stderr, "Error: Could not create socket: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	/* Don't steal the socket of a running daemon */
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		fprintf(stderr, "Error: Another i2cd is listening on %s\n",
+			path);
+		close(sock);
+		return -1;
+	}
+	unlink(path);
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+	 || listen(sock, SOMAXCONN) < 0) {
+		fprintf(stderr, "Error: Could not listen on %s: %s\n",
+			path, strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/* Take back the clients the bus workers are done with, and send their
+   replies */
+static void reap_jobs(void)
+{
+	struct client *c, *next;
+	eventfd_t count;
+
+	eventfd_read(done_fd, &count);
+	pthread_mutex_lock(&done_lock);
+	c = done_list;
+	done_list = NULL;
+	pthread_mutex_unlock(&done_lock);
+
+	for (; c; c = next) {
+		next = c->next;
+		c->busy = 0;
+		if (c->dead || (c->out_len && flush_reply(c) < 0))
+			drop_client(c);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = I2CD_SOCKET;
+	struct pollfd pfd[2 + 2 * MAX_CLIENTS];
+	struct client *polled[2 * MAX_CLIENTS];
+	struct sigaction sa;
+	struct client *c;
+	int sock, fd, i, n, nsock, flags = 0, version = 0;
+
+	/* handle (optional) flags first */
+	while (1+flags < argc && argv[1+flags][0] == '-') {
+		switch (argv[1+flags][1]) {
+		case 'V': version = 1; break;
+		case 's':
+			if (2+flags < argc)
+				path = argv[2+flags];
+			flags++;
+			break;
+		default:
+			fprintf(stderr, "Error: Unsupported option "
+				"\"%s\"!\n", argv[1+flags]);
+			help();
+			exit(1);
+		}
+		flags++;
+	}
+
+	if (version) {
+		fprintf(stderr, "i2cd version %s\n", VERSION);
+		exit(0);
+	}
+
+	if (1+flags != argc) {
+		help();
+		exit(1);
+	}
+
+	done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (done_fd < 0) {
+		fprintf(stderr, "Error: Could not create eventfd: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+
+	sock = listen_socket(path);
+	if (sock < 0)
+		exit(1);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while (!stop) {
+		/* Forget about the clients which are gone */
+		for (i = n = 0; i < nclients; i++) {
+			if (clients[i]->fd < 0) {
+				free(clients[i]);
+				continue;
+			}
+			clients[n++] = clients[i];
+		}
+		nclients = n;
+
+		pfd[0].fd = sock;
+		pfd[0].events = nclients < MAX_CLIENTS ? POLLIN : 0;
+		pfd[1].fd = done_fd;
+		pfd[1].events = POLLIN;
+
+		/* The bus workers own the busy clients */
+		for (i = n = 0; i < nclients; i++) {
+			c = clients[i];
+			if (c->busy)
+				continue;
+			pfd[2 + n].fd = c->fd;
+			pfd[2 + n].events = c->out_len ? POLLOUT : POLLIN;
+			polled[n++] = c;
+		}
+		/* Then the ring doorbells */
+		nsock = n;
+		for (i = 0; i < nclients; i++) {
+			c = clients[i];
+			if (!c->ring || c->busy)
+				continue;
+			pfd[2 + n].fd = c->sq_fd;
+			pfd[2 + n].events = POLLIN;
+			polled[n++] = c;
+		}
+
+		if (poll(pfd, 2 + n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Error: poll failed: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		if (pfd[1].revents & POLLIN)
+			reap_jobs();
+
+		for (i = 0; i < n; i++) {
+			c = polled[i];
+			/* Handed over already, polled again once back */
+			if (!pfd[2 + i].revents || c->fd < 0 || c->busy)
+				continue;
+
+			if (i >= nsock) {
+				c->ring_pending = 1;
+				queue_job(c);
+				continue;
+			}
+
+			if (c->out_len) {
+				if (flush_reply(c) < 0)
+					drop_client(c);
+				continue;
+			}
+
+			switch (receive(c)) {
+			case 1:
+				c->ready = 1;
+				/* Nothing to do on a bus yet */
+				if (c->bus && c->req.op != I2CD_OPEN) {
+					queue_job(c);
+					break;
+				}
+				if (serve(c) < 0 || flush_reply(c) < 0)
+					drop_client(c);
+				break;
+			case -1:
+				drop_client(c);
+				break;
+			}
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			fd = accept4(sock, NULL, NULL,
+				     SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd >= 0) {
+				c = calloc(1, sizeof(*c));
+				if (!c) {
+					close(fd);
+					continue;
+				}
+				c->fd = fd;
+				c->addr = -1;
+				clients[nclients++] = c;
+			}
+		}
+	}
+
+	close(sock);
+	unlink(path);
+	exit(0);
+}
@@ -28,6 +28,8 @@
 #include <unistd.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <i2c/lock.h>
+#include <i2c/remote.h>
 #include <i2c/smbus.h>
 #include "i2cbusses.h"
 #include "util.h"
@@ -36,7 +38,7 @@
 static void help(void)
 {
 	fprintf(stderr,
-		"Usage: i2cdump [-f] [-y] [-r first-last] I2CBUS ADDRESS [MODE [BANK [BANKREG]]]\n"
+		"Usage: i2cdump [-f] [-y] [-a] [-r first-last] [-D SOCKET] I2CBUS ADDRESS [MODE [BANK [BANKREG]]]\n"
 		"  I2CBUS is an integer or an I2C bus name\n"
 		"  ADDRESS is an integer (0x03 - 0x77)\n"
 		"  MODE is one of:\n"
@@ -46,20 +48,30 @@ static void help(void)
 		"    s (SMBus block)\n"
 		"    i (I2C block)\n"
 		"    c (consecutive byte)\n"
-		"    Append p for SMBus PEC\n");
+		"    Append p for SMBus PEC\n"
+		"  -a uses 16-bit data addresses (I2C block reads, mode b or i only)\n"
+		"  -D goes through the i2cd daemon listening on SOCKET\n");
 }
 
-static int check_funcs(int file, int size, int pec)
+static int check_funcs(int file, int size, int pec, int addr16)
 {
 	unsigned long funcs;
 
 	/* check adapter functionality */
-	if (ioctl(file, I2C_FUNCS, &funcs) < 0) {
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0) {
 		fprintf(stderr, "Error: Could not get the adapter "
 			"functionality matrix: %s\n", strerror(errno));
 		return -1;
 	}
 
+	if (addr16) {
+		if (!(funcs & I2C_FUNC_I2C)) {
+			fprintf(stderr, MISSING_FUNC_FMT, "I2C transfers");
+			return -1;
+		}
+		return 0;
+	}
+
 	switch(size) {
 	case I2C_SMBUS_BYTE:
 		if (!(funcs & I2C_FUNC_SMBUS_READ_BYTE)) {
@@ -110,25 +122,118 @@ static int check_funcs(int file, int size, int pec)
 	return 0;
 }
 
+/*
+ * Read len bytes starting at 16-bit data address offset. Each ioctl
+ * writes the two address bytes and then reads as much as i2c-dev lets
+ * us in a single message, relying on the address auto-increment.
+ */
+static int read_addr16(int file, int address, int offset, int len,
+		       unsigned char *buf)
+{
+	struct i2c_rdwr_ioctl_data rdwr;
+	struct i2c_msg msgs[2];
+	unsigned char abuf[2];
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = 2;
+
+	while (len > 0) {
+		int chunk = len > I2C_DEV_MSG_MAX ? I2C_DEV_MSG_MAX : len;
+
+		abuf[0] = offset >> 8;
+		abuf[1] = offset & 0xff;
+		msgs[0].addr = address;
+		msgs[0].flags = 0;
+		msgs[0].len = 2;
+		msgs[0].buf = abuf;
+		msgs[1].addr = address;
+		msgs[1].flags = I2C_M_RD;
+		msgs[1].len = chunk;
+		msgs[1].buf = buf;
+
+		if (i2c_ioctl(file, I2C_RDWR, &rdwr) < 0)
+			return -errno;
+
+		offset += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static void dump_addr16(int file, int address, int first, int last)
+{
+	unsigned char *buf;
+	int i, j, res;
+
+	buf = malloc(last - first + 1);
+	if (!buf) {
+		fprintf(stderr, "Error: Could not allocate buffer memory.\n");
+		exit(1);
+	}
+
+	res = read_addr16(file, address, first, last - first + 1, buf);
+	if (res < 0) {
+		fprintf(stderr, "Error: Block read failed: %s\n",
+			strerror(-res));
+		exit(1);
+	}
+
+	printf("       0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f"
+	       "    0123456789abcdef\n");
+	for (i = first & ~0xf; i <= last; i += 16) {
+		printf("%04x: ", i);
+		for (j = 0; j < 16; j++) {
+			if (i+j < first || i+j > last)
+				printf("   ");
+			else
+				printf("%02x ", buf[i+j-first]);
+		}
+		printf("   ");
+
+		for (j = 0; j < 16; j++) {
+			if (i+j < first || i+j > last) {
+				printf(" ");
+				continue;
+			}
+
+			res = buf[i+j-first];
+			if (res == 0x00 || res == 0xff)
+				printf(".");
+			else if (res < 32 || res >= 127)
+				printf("?");
+			else
+				printf("%c", res);
+		}
+		printf("\n");
+	}
+
+	free(buf);
+}
+
 int main(int argc, char *argv[])
 {
 	char *end;
 	int i, j, res, i2cbus, address, size, file;
 	int bank = 0, bankreg = 0x4E, old_bank = 0;
+	int lock = -1;
 	char filename[20];
 	int block[256], s_length = 0;
-	int pec = 0, even = 0;
+	int pec = 0, even = 0, addr16 = 0;
 	int flags = 0;
 	int force = 0, yes = 0, version = 0;
-	const char *range = NULL;
-	int first = 0x00, last = 0xff;
+	const char *range = NULL, *i2cd_socket = NULL;
+	int first = 0x00, last = 0xff, maxreg;
 
 	/* handle (optional) flags first */
 	while (1+flags < argc && argv[1+flags][0] == '-') {
 		switch (argv[1+flags][1]) {
 		case 'V': version = 1; break;
+		case 'a': addr16 = 1; break;
 		case 'f': force = 1; break;
 		case 'r': range = argv[1+(++flags)]; break;
+		case 'D': i2cd_socket = argv[1+(++flags)]; break;
 		case 'y': yes = 1; break;
 		default:
 			fprintf(stderr, "Error: Unsupported option "
@@ -229,25 +334,41 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (addr16) {
+		if (size != I2C_SMBUS_BYTE_DATA
+		 && size != I2C_SMBUS_I2C_BLOCK_DATA) {
+			fprintf(stderr, "Error: 16-bit data addresses are "
+				"only supported in modes b and i!\n");
+			exit(1);
+		}
+		if (pec || argc > flags + 4) {
+			fprintf(stderr, "Error: PEC and banks are not "
+				"supported with 16-bit data addresses!\n");
+			exit(1);
+		}
+		last = maxreg = 0xffff;
+	} else
+		maxreg = 0xff;
+
 	/* Parse optional range string */
 	if (range) {
 		char *dash;
 
 		first = strtol(range, &dash, 0);
 		if (dash == range || *dash != '-'
-		 || first < 0 || first > 0xff) {
+		 || first < 0 || first > maxreg) {
 			fprintf(stderr, "Error: Invalid range parameter!\n");
 			exit(1);
 		}
 		last = strtol(++dash, &end, 0);
 		if (end == dash || *end != '\0'
-		 || last < first || last > 0xff) {
+		 || last < first || last > maxreg) {
 			fprintf(stderr, "Error: Invalid range parameter!\n");
 			exit(1);
 		}
 
 		/* Check mode constraints */
-		switch (size) {
+		switch (addr16 ? I2C_SMBUS_BYTE : size) {
 		case I2C_SMBUS_BYTE:
 		case I2C_SMBUS_BYTE_DATA:
 			break;
@@ -262,14 +383,14 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	file = open_i2c_dev(i2cbus, filename, sizeof(filename), 0);
+	file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
 	if (file < 0
-	 || check_funcs(file, size, pec)
+	 || check_funcs(file, size, pec, addr16)
 	 || set_slave_addr(file, address, force))
 		exit(1);
 
 	if (pec) {
-		if (ioctl(file, I2C_PEC, 1) < 0) {
+		if (i2c_ioctl(file, I2C_PEC, 1) < 0) {
 			fprintf(stderr, "Error: Could not set PEC: %s\n",
 				strerror(errno));
 			exit(1);
@@ -282,6 +403,7 @@ int main(int argc, char *argv[])
 
 		fprintf(stderr, "I will probe file %s, address 0x%x, mode "
 			"%s\n", filename, address,
+			addr16 ? "i2c block, 16-bit data addresses" :
 			size == I2C_SMBUS_BLOCK_DATA ? "smbus block" :
 			size == I2C_SMBUS_I2C_BLOCK_DATA ? "i2c block" :
 			size == I2C_SMBUS_BYTE ? "byte consecutive read" :
@@ -301,8 +423,8 @@ int main(int argc, char *argv[])
 		}
 		if (range) {
 			fprintf(stderr,
-				"Probe range limited to 0x%02x-0x%02x.\n",
-				first, last);
+				"Probe range limited to 0x%0*x-0x%0*x.\n",
+				addr16 ? 4 : 2, first, addr16 ? 4 : 2, last);
 		}
 
 		fprintf(stderr, "Continue? [Y/n] ");
@@ -313,6 +435,18 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* Keep cooperating processes from moving the address pointer or
+	   switching banks under our feet */
+	if ((addr16 || size == I2C_SMBUS_BYTE
+	  || (bank && size != I2C_SMBUS_BLOCK_DATA))
+	 && lock_chip(i2cbus, address, &lock))
+		exit(1);
+
+	if (addr16) {
+		dump_addr16(file, address, first, last);
+		goto done;
+	}
+
 	/* See Winbond w83781d data sheet for bank details */
 	if (bank && size != I2C_SMBUS_BLOCK_DATA) {
 		res = i2c_smbus_read_byte_data(file, bankreg);
@@ -483,8 +617,11 @@ int main(int argc, char *argv[])
 			printf("\n");
 		}
 	}
-	if (bank && size != I2C_SMBUS_BLOCK_DATA) {
+	if (bank && size != I2C_SMBUS_BLOCK_DATA)
 		i2c_smbus_write_byte_data(file, bankreg, old_bank);
-	}
+
+done:
+	i2c_unlock_chip(lock);
+	close(file);
 	exit(0);
 }
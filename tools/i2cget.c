@@ -23,14 +23,23 @@
     MA 02110-1301 USA.
 */
 
+/* For sched_setaffinity and CPU_SET */
+#define _GNU_SOURCE 1
+
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <i2c/lock.h>
+#include <i2c/remote.h>
 #include <i2c/smbus.h>
 #include "i2cbusses.h"
 #include "util.h"
@@ -41,23 +50,36 @@ static void help(void) __attribute__ ((noreturn));
 static void help(void)
 {
 	fprintf(stderr,
-		"Usage: i2cget [-f] [-y] [-l <length>] I2CBUS CHIP-ADDRESS [DATA-ADDRESS [MODE]]\n"
+		"Usage: i2cget [-f] [-y] [-j] [-l <length>] [-D SOCKET] I2CBUS CHIP-ADDRESS [DATA-ADDRESS [MODE]]\n"
+		"       i2cget [-f] [-y] -S RATE [-n COUNT] [-B] [-C CPU] [-R] I2CBUS CHIP-ADDRESS [DATA-ADDRESS [MODE]]\n"
+		"       i2cget [-f] [-y] --until MASK=VALUE [--timeout MS] I2CBUS CHIP-ADDRESS DATA-ADDRESS [MODE]\n"
 		"  I2CBUS is an integer or an I2C bus name\n"
 		"  ADDRESS is an integer (0x03 - 0x77)\n"
+		"  CHIP-ADDRESS and DATA-ADDRESS can also be lists of values and\n"
+		"    ranges, such as 0x10,0x20-0x2f, to read several registers\n"
 		"  MODE is one of:\n"
 		"    b (read byte data, default)\n"
 		"    w (read word data)\n"
 		"    c (write byte/read byte)\n"
-		"    Append p for SMBus PEC\n");
+		"    i (read byte data, I2C block reads for contiguous registers)\n"
+		"    Append p for SMBus PEC\n"
+		"  -j prints the results in JSON format\n"
+		"  -S samples the register RATE times per second (COUNT times, or\n"
+		"    until interrupted), printing CSV or binary (-B) timestamped\n"
+		"    values; -C pins to a CPU, -R uses real-time scheduling\n"
+		"  --until (-u) polls the register until the bits in MASK equal\n"
+		"    VALUE, for up to MS milliseconds (--timeout or -t, default 1000)\n"
+		"    Exit status is 0 on match, 3 on timeout, 2 on read error\n"
+		"  -D goes through the i2cd daemon listening on SOCKET\n");
 	exit(1);
 }
 
-static int check_funcs(int file, int size, int daddress, int pec)
+static int check_funcs(int file, int size, int daddress, int pec, int length)
 {
 	unsigned long funcs;
 
 	/* check adapter functionality */
-	if (ioctl(file, I2C_FUNCS, &funcs) < 0) {
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0) {
 		fprintf(stderr, "Error: Could not get the adapter "
 			"functionality matrix: %s\n", strerror(errno));
 		return -1;
@@ -69,14 +91,21 @@ static int check_funcs(int file, int size, int daddress, int pec)
 			fprintf(stderr, MISSING_FUNC_FMT, "SMBus receive byte");
 			return -1;
 		}
-		if (daddress >= 0
+		if (daddress >= 0 && daddress <= 0xff
 		 && !(funcs & I2C_FUNC_SMBUS_WRITE_BYTE)) {
 			fprintf(stderr, MISSING_FUNC_FMT, "SMBus send byte");
 			return -1;
 		}
+		if (daddress > 0xff
+		 && !(funcs & I2C_FUNC_SMBUS_WRITE_BYTE_DATA)) {
+			fprintf(stderr, MISSING_FUNC_FMT, "SMBus write byte");
+			return -1;
+		}
 		break;
 
 	case I2C_SMBUS_BYTE_DATA:
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		/* I2C block reads are optional, we fall back to byte reads */
 		if (!(funcs & I2C_FUNC_SMBUS_READ_BYTE_DATA)) {
 			fprintf(stderr, MISSING_FUNC_FMT, "SMBus read byte");
 			return -1;
@@ -91,6 +120,11 @@ static int check_funcs(int file, int size, int daddress, int pec)
 		break;
 	}
 
+	if (length && !(funcs & I2C_FUNC_I2C)) {
+		fprintf(stderr, MISSING_FUNC_FMT, "I2C transfers");
+		return -1;
+	}
+
 	if (pec
 	 && !(funcs & (I2C_FUNC_SMBUS_PEC | I2C_FUNC_I2C))) {
 		fprintf(stderr, "Warning: Adapter does "
@@ -150,44 +184,491 @@ static int confirm(const char *filename, int address, int size, int daddress,
 	return 1;
 }
 
-static void writeaddr(int file, int adr, int len)
+static int confirm_batch(const char *filename, const int *chips, int nchips,
+			 const int *regs, int nregs, int size, int pec)
 {
+	int i, dont = 0;
+
+	fprintf(stderr, "WARNING! This program can confuse your I2C "
+		"bus, cause data loss and worse!\n");
+
+	for (i = 0; i < nchips; i++) {
+		if (chips[i] >= 0x50 && chips[i] <= 0x57 && pec) {
+			fprintf(stderr, "STOP! EEPROMs are I2C devices, not "
+				"SMBus devices. Using PEC\non I2C devices may "
+				"result in unexpected results, such as\n"
+				"trashing the contents of EEPROMs. We can't "
+				"let you do that, sorry.\n");
+			return 0;
+		}
+	}
+
+	if (size == I2C_SMBUS_BYTE && nregs && pec) {
+		fprintf(stderr, "WARNING! All I2C chips and some SMBus chips "
+			"will interpret a write\nbyte command with PEC as a"
+			"write byte data command, effectively writing a\n"
+			"value into a register!\n");
+		dont++;
+	}
+
+	fprintf(stderr, "I will read from device file %s, %d chip "
+		"address(es) from 0x%02x, ", filename, nchips, chips[0]);
+	if (!nregs)
+		fprintf(stderr, "current data\naddress");
+	else
+		fprintf(stderr, "%d data address(es)\nfrom 0x%02x", nregs,
+			regs[0]);
+	fprintf(stderr, ", using %s.\n",
+		size == I2C_SMBUS_BYTE ? (!nregs ?
+		"read byte" : "write byte/read byte") :
+		size == I2C_SMBUS_I2C_BLOCK_DATA ? "i2c block read" :
+		size == I2C_SMBUS_BYTE_DATA ? "read byte data" :
+		"read word data");
+	if (pec)
+		fprintf(stderr, "PEC checking enabled.\n");
+
+	fprintf(stderr, "Continue? [%s] ", dont ? "y/N" : "Y/n");
+	fflush(stderr);
+	if (!user_ack(!dont)) {
+		fprintf(stderr, "Aborting on user request.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Parse a comma-separated list of values and first-last ranges, all
+ * between min and max, into a newly allocated array. Returns the number
+ * of entries, or -1 if the list is invalid.
+ */
+static int parse_list(const char *arg, int min, int max, int **list)
+{
+	int *l = NULL, *tmp, n = 0, first, last;
+	const char *p = arg;
+	char *end;
+
+	do {
+		first = strtol(p, &end, 0);
+		if (end == p || first < min || first > max)
+			goto err;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 0);
+			if (end == p || last < first || last > max)
+				goto err;
+		}
+		if (*end && *end != ',')
+			goto err;
+
+		tmp = realloc(l, (n + last - first + 1) * sizeof(int));
+		if (!tmp)
+			goto err;
+		l = tmp;
+		while (first <= last)
+			l[n++] = first++;
+		p = end + 1;
+	} while (*end);
+
+	*list = l;
+	return n;
+
+ err:
+	free(l);
+	return -1;
+}
+
+static void print_result(int chip, int reg, int res, int size, int json,
+			 int first)
+{
+	if (json) {
+		printf("%s\n  { \"chip\": %d, \"register\": ",
+		       first ? "" : ",", chip);
+		if (reg < 0)
+			printf("null");
+		else
+			printf("%d", reg);
+		if (res < 0)
+			printf(", \"value\": null }");
+		else
+			printf(", \"value\": %d }", res);
+		return;
+	}
+
+	printf("0x%02x ", chip);
+	if (reg < 0)
+		printf("- ");
+	else
+		printf("0x%02x ", reg);
+	if (res < 0)
+		printf("XX\n");
+	else
+		printf("0x%0*x\n", size == I2C_SMBUS_WORD_DATA ? 4 : 2, res);
+}
+
 #define MAX_ADDR_LEN 2
 
-	char buf[MAX_ADDR_LEN];
-	int i;
+/*
+ * Write the data address before a current address read. This goes
+ * through i2c_ioctl() rather than write(), so that it also works with -D.
+ */
+static int writeaddr(int file, int adr, int len)
+{
+	if (adr < 0)
+		return 0;
+	if (len >= MAX_ADDR_LEN)
+		return i2c_smbus_write_byte_data(file, (adr >> 8) & 0xff,
+						 adr & 0xff);
+	return i2c_smbus_write_byte(file, adr & 0xff);
+}
+
+/* Data address write and read of length bytes, in a single transfer */
+static int read_length(int file, int address, int adr, int len,
+		       unsigned char *buf, int length)
+{
+	struct i2c_rdwr_ioctl_data rdwr;
+	struct i2c_msg msgs[2];
+	unsigned char abuf[MAX_ADDR_LEN];
+	int i, n = 0;
 
 	if (adr >= 0) {
 		if (len > MAX_ADDR_LEN)
 			len = MAX_ADDR_LEN;
-
 		for (i = 0; i < len; i++)
-			buf[i] = (adr >> (8 * (len - 1 - i))) & 0xff;
+			abuf[i] = (adr >> (8 * (len - 1 - i))) & 0xff;
+		msgs[n].addr = address;
+		msgs[n].flags = 0;
+		msgs[n].len = len;
+		msgs[n].buf = abuf;
+		n++;
+	}
+	msgs[n].addr = address;
+	msgs[n].flags = I2C_M_RD;
+	msgs[n].len = length;
+	msgs[n].buf = buf;
+	n++;
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = n;
+	if (i2c_ioctl(file, I2C_RDWR, &rdwr) < 0)
+		return -errno;
+	return length;
+}
+
+static int read_register(int file, int i2cbus, int address, int size,
+			 int daddress, int daddrlen)
+{
+	int res, lock;
+
+	switch (size) {
+	case I2C_SMBUS_BYTE:
+		if (daddress < 0)
+			return i2c_smbus_read_byte(file);
+		/* Keep cooperating processes from moving the address pointer
+		   between the write and the read */
+		if (lock_chip(i2cbus, address, &lock))
+			return -EBUSY;
+		res = writeaddr(file, daddress, daddrlen);
+		if (res >= 0)
+			res = i2c_smbus_read_byte(file);
+		i2c_unlock_chip(lock);
+		return res;
+	case I2C_SMBUS_WORD_DATA:
+		return i2c_smbus_read_word_data(file, daddress);
+	default: /* I2C_SMBUS_BYTE_DATA */
+		return i2c_smbus_read_byte_data(file, daddress);
+	}
+}
+
+/*
+ * Read all registers of all chips on the same file. With I2C block mode,
+ * runs of contiguous registers are read in a single transaction.
+ * Returns the number of failed reads.
+ */
+static int read_batch(int file, int i2cbus, int force, int size, int json,
+		      const int *chips, int nchips, const int *regs, int nregs)
+{
+	int c, i, j, n, res, errors = 0, first = 1;
+	int block = size == I2C_SMBUS_I2C_BLOCK_DATA;
+	unsigned char buf[I2C_SMBUS_BLOCK_MAX];
+	unsigned long funcs;
+
+	/* Without I2C block reads, mode i falls back to byte data reads */
+	if (block && (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0
+		   || !(funcs & I2C_FUNC_SMBUS_READ_I2C_BLOCK)))
+		block = 0;
+
+	if (json)
+		printf("[");
+
+	for (c = 0; c < nchips; c++) {
+		int slave_err = set_slave_addr(file, chips[c], force);
+
+		if (!nregs) {
+			res = slave_err ? slave_err : i2c_smbus_read_byte(file);
+			if (res < 0)
+				errors++;
+			print_result(chips[c], -1, res, size, json, first);
+			first = 0;
+			continue;
+		}
+
+		for (i = 0; i < nregs; i += n) {
+			/* Find the run of contiguous registers */
+			for (n = 1; block && i + n < nregs
+			     && n < I2C_SMBUS_BLOCK_MAX
+			     && regs[i + n] == regs[i] + n; n++)
+				;
+
+			res = -1;
+			if (!slave_err && n > 1) {
+				res = i2c_smbus_read_i2c_block_data(file,
+						regs[i], n, buf);
+				/* Don't try again if the adapter can't */
+				if (res == -EOPNOTSUPP)
+					block = 0;
+			}
+
+			for (j = 0; j < n; j++) {
+				int value;
+
+				if (slave_err)
+					value = slave_err;
+				else if (res == n)
+					value = buf[j];
+				else
+					value = read_register(file, i2cbus,
+							chips[c], size,
+							regs[i + j], 1);
+
+				if (value < 0)
+					errors++;
+				print_result(chips[c], regs[i + j], value,
+					     size, json, first);
+				first = 0;
+			}
+		}
+	}
+
+	if (json)
+		printf("\n]\n");
+
+	return errors;
+}
+
+static volatile sig_atomic_t stop_sampling;
+
+static void sampling_stop(int sig)
+{
+	(void)sig;
+	stop_sampling = 1;
+}
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static long long timespec_diff_ns(const struct timespec *a,
+				  const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000LL
+	       + (a->tv_nsec - b->tv_nsec);
+}
+
+static void sampling_setup(int cpu, int realtime)
+{
+	if (cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) < 0)
+			fprintf(stderr, "Warning: Could not pin to CPU %d: "
+				"%s\n", cpu, strerror(errno));
+	}
 
-		if (write(file, buf, len) != len)
-			fprintf(stderr, "Warning - write failed\n");
+	if (realtime) {
+		struct sched_param param;
+
+		param.sched_priority = (sched_get_priority_min(SCHED_FIFO)
+				     + sched_get_priority_max(SCHED_FIFO)) / 2;
+		if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+			fprintf(stderr, "Warning: Could not use real-time "
+				"scheduling: %s\n", strerror(errno));
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+			fprintf(stderr, "Warning: Could not lock memory: "
+				"%s\n", strerror(errno));
 	}
 }
 
+/*
+ * Read the register at fixed absolute deadlines. Each sample is stamped
+ * with CLOCK_MONOTONIC just before the read. Deadlines which passed while
+ * we were busy are skipped and counted as overruns, so that the sampling
+ * grid never drifts.
+ */
+static int sample_register(int file, int i2cbus, int address, int size,
+			   int daddress, int daddrlen, double rate, long count,
+			   int binary)
+{
+	struct timespec next, now;
+	struct sigaction sa;
+	long period = 1000000000 / rate;
+	long n, errors = 0, overruns = 0;
+	long long late, max_late = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sampling_stop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (!binary)
+		printf("time,value\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (n = 0; !count || n < count; n++) {
+		__u64 ns;
+		__s32 res;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				       NULL) == EINTR && !stop_sampling)
+			;
+		if (stop_sampling)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		res = read_register(file, i2cbus, address, size, daddress,
+				    daddrlen);
+		if (res < 0)
+			errors++;
+
+		late = timespec_diff_ns(&now, &next);
+		if (late > max_late)
+			max_late = late;
+
+		ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+		if (binary) {
+			/* 12-byte records: u64 time in ns, s32 value */
+			fwrite(&ns, sizeof(ns), 1, stdout);
+			fwrite(&res, sizeof(res), 1, stdout);
+		} else if (res < 0) {
+			printf("%ld.%09ld,XX\n", (long)now.tv_sec,
+			       now.tv_nsec);
+		} else {
+			printf("%ld.%09ld,0x%0*x\n", (long)now.tv_sec,
+			       now.tv_nsec,
+			       size == I2C_SMBUS_WORD_DATA ? 4 : 2, res);
+		}
+
+		/* Schedule the next sample, skipping missed deadlines */
+		timespec_add_ns(&next, period);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		while (timespec_diff_ns(&now, &next) > 0) {
+			timespec_add_ns(&next, period);
+			overruns++;
+		}
+	}
+	fflush(stdout);
+
+	fprintf(stderr, "%ld samples, %ld read errors, %ld overruns, "
+		"max latency %lld us\n", n, errors, overruns,
+		max_late / 1000);
+
+	return errors ? 2 : 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int res, i;
-	char *resbufptr;
+	unsigned char *resbufptr;
 	char *end;
 	int i2cbus, address, size, file;
 	int daddress, daddrlen = 0;
 	char filename[20];
 	int pec = 0;
 	int flags = 0;
-	int force = 0, yes = 0, version = 0;
+	int force = 0, yes = 0, version = 0, json = 0;
 	int length = 0;
+	int *chips = NULL, nchips = 1, *regs = NULL, nregs = 0;
+	double rate = 0;
+	long count = 0;
+	int binary = 0, cpu = -1, realtime = 0;
+	const char *until = NULL, *i2cd_socket = NULL;
+	long umask = 0, uvalue = 0, timeout = 0;
 
 	/* handle (optional) flags first */
 	while (1+flags < argc && argv[1+flags][0] == '-') {
-		switch (argv[1+flags][1]) {
+		int opt = argv[1+flags][1];
+
+		/* A few options also have a long name */
+		if (opt == '-') {
+			if (!strcmp(argv[1+flags], "--until"))
+				opt = 'u';
+			else if (!strcmp(argv[1+flags], "--timeout"))
+				opt = 't';
+		}
+
+		switch (opt) {
 		case 'V': version = 1; break;
 		case 'f': force = 1; break;
 		case 'y': yes = 1; break;
+		case 'j': json = 1; break;
+		case 'B': binary = 1; break;
+		case 'R': realtime = 1; break;
+		case 'S':
+			if (2+flags < argc)
+				rate = strtod(argv[2+flags], &end);
+			if (2+flags >= argc || *end || rate <= 0
+			 || rate > 1000000) {
+				fprintf(stderr, "Error: Invalid sampling rate\n");
+				exit(1);
+			}
+			flags++;
+			break;
+		case 'n':
+			if (2+flags < argc)
+				count = strtol(argv[2+flags], &end, 0);
+			if (2+flags >= argc || *end || count <= 0) {
+				fprintf(stderr, "Error: Invalid sample count\n");
+				exit(1);
+			}
+			flags++;
+			break;
+		case 'u':
+			if (2+flags < argc)
+				until = argv[2+flags];
+			flags++;
+			break;
+		case 'D':
+			if (2+flags < argc)
+				i2cd_socket = argv[2+flags];
+			flags++;
+			break;
+		case 't':
+			if (2+flags < argc)
+				timeout = strtol(argv[2+flags], &end, 0);
+			if (2+flags >= argc || *end || timeout <= 0) {
+				fprintf(stderr, "Error: Invalid timeout\n");
+				exit(1);
+			}
+			flags++;
+			break;
+		case 'C':
+			if (2+flags < argc)
+				cpu = strtol(argv[2+flags], &end, 0);
+			if (2+flags >= argc || *end || cpu < 0) {
+				fprintf(stderr, "Error: Invalid CPU number\n");
+				exit(1);
+			}
+			flags++;
+			break;
 		case 'l': /* Number of bytes to read */
 			/* Handle both options:
 			 * - length is part of this argument
@@ -197,7 +678,7 @@ int main(int argc, char *argv[])
 				length = strtol(argv[2+flags], &end, 0);
 				flags++;
 			}
-			if (*end || !length) {
+			if (*end || length <= 0 || length > 8192) {
 				fprintf(stderr, "Error: Length not specified\n");
 				exit(1);
 			}
@@ -223,11 +704,28 @@ int main(int argc, char *argv[])
 	if (i2cbus < 0)
 		help();
 
-	address = parse_i2c_address(argv[flags+2]);
-	if (address < 0)
-		help();
+	if (strpbrk(argv[flags+2], ",-")) {
+		nchips = parse_list(argv[flags+2], 0x03, 0x77, &chips);
+		if (nchips < 0) {
+			fprintf(stderr, "Error: Chip address list invalid!\n");
+			help();
+		}
+		address = chips[0];
+	} else {
+		address = parse_i2c_address(argv[flags+2]);
+		if (address < 0)
+			help();
+	}
 
-	if (argc > flags + 3) {
+	if (argc > flags + 3 && strpbrk(argv[flags+3], ",-")) {
+		size = I2C_SMBUS_BYTE_DATA;
+		nregs = parse_list(argv[flags+3], 0x00, 0xff, &regs);
+		if (nregs < 0) {
+			fprintf(stderr, "Error: Data address list invalid!\n");
+			help();
+		}
+		daddress = regs[0];
+	} else if (argc > flags + 3) {
 		size = I2C_SMBUS_BYTE_DATA;
 		daddress = strtol(argv[flags+3], &end, 0);
 		if (!*end && daddress >= 0) {
@@ -248,52 +746,183 @@ int main(int argc, char *argv[])
 		case 'b': size = I2C_SMBUS_BYTE_DATA; break;
 		case 'w': size = I2C_SMBUS_WORD_DATA; break;
 		case 'c': size = I2C_SMBUS_BYTE; break;
+		case 'i': size = I2C_SMBUS_I2C_BLOCK_DATA; break;
 		default:
 			fprintf(stderr, "Error: Invalid mode!\n");
 			help();
 		}
 		pec = argv[flags+4][1] == 'p';
+		if (pec && size == I2C_SMBUS_I2C_BLOCK_DATA) {
+			fprintf(stderr, "Error: PEC not supported for I2C block reads!\n");
+			help();
+		}
+	}
+
+	if ((count || binary || cpu >= 0 || realtime) && !rate) {
+		fprintf(stderr, "Error: Sampling options require -S!\n");
+		help();
+	}
+	if (rate && (nchips > 1 || nregs > 1 || json || length)) {
+		fprintf(stderr, "Error: Sampling only supports a single register!\n");
+		help();
+	}
+
+	if (timeout && !until) {
+		fprintf(stderr, "Error: --timeout requires --until!\n");
+		help();
+	}
+	if (!timeout)
+		timeout = 1000;
+
+	if (until) {
+		char *eq;
+
+		umask = strtol(until, &eq, 0);
+		if (eq == until || *eq != '=') {
+			fprintf(stderr, "Error: Invalid condition, expected MASK=VALUE\n");
+			help();
+		}
+		uvalue = strtol(eq + 1, &end, 0);
+		if (end == eq + 1 || *end || umask <= 0 || uvalue < 0
+		 || (uvalue & ~umask)
+		 || umask > (size == I2C_SMBUS_WORD_DATA ? 0xffff : 0xff)) {
+			fprintf(stderr, "Error: Invalid condition, expected MASK=VALUE\n");
+			help();
+		}
+		if (daddress < 0 || daddress > 0xff
+		 || (size != I2C_SMBUS_BYTE_DATA && size != I2C_SMBUS_WORD_DATA)
+		 || nchips > 1 || nregs > 1 || json || length || rate) {
+			fprintf(stderr, "Error: Polling only supports a single register in mode b or w!\n");
+			help();
+		}
 	}
 
-	file = open_i2c_dev(i2cbus, filename, sizeof(filename), 0);
+	/* Several registers, or structured output, use the batch code */
+	if (nchips > 1 || nregs > 1 || json) {
+		if (length) {
+			fprintf(stderr, "Error: Length not supported when reading several registers!\n");
+			help();
+		}
+		if (!chips) {
+			chips = malloc(sizeof(int));
+			if (!chips) {
+				fprintf(stderr, "Error: Out of memory!\n");
+				exit(1);
+			}
+			chips[0] = address;
+		}
+		if (!regs && daddress >= 0) {
+			if (daddress > 0xff) {
+				fprintf(stderr, "Error: Data address invalid!\n");
+				help();
+			}
+			regs = malloc(sizeof(int));
+			if (!regs) {
+				fprintf(stderr, "Error: Out of memory!\n");
+				exit(1);
+			}
+			regs[0] = daddress;
+			nregs = 1;
+		}
+
+		file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
+		if (file < 0
+		 || check_funcs(file, size, daddress, pec, length))
+			exit(1);
+
+		if (!yes && !confirm_batch(filename, chips, nchips, regs,
+					   nregs, size, pec))
+			exit(0);
+
+		if (pec && i2c_ioctl(file, I2C_PEC, 1) < 0) {
+			fprintf(stderr, "Error: Could not set PEC: %s\n",
+				strerror(errno));
+			close(file);
+			exit(1);
+		}
+
+		res = read_batch(file, i2cbus, force, size, json, chips,
+				 nchips, regs, nregs);
+		close(file);
+		free(chips);
+		free(regs);
+
+		if (res) {
+			fprintf(stderr, "Error: %d read(s) failed\n", res);
+			exit(2);
+		}
+		return 0;
+	}
+
+	/* A single register has nothing to merge */
+	if (size == I2C_SMBUS_I2C_BLOCK_DATA)
+		size = I2C_SMBUS_BYTE_DATA;
+
+	file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
 	if (file < 0
-	 || check_funcs(file, size, daddress, pec)
+	 || check_funcs(file, size, daddress, pec, length)
 	 || set_slave_addr(file, address, force))
 		exit(1);
 
 	if (!yes && !confirm(filename, address, size, daddress, pec))
 		exit(0);
 
-	if (pec && ioctl(file, I2C_PEC, 1) < 0) {
+	if (pec && i2c_ioctl(file, I2C_PEC, 1) < 0) {
 		fprintf(stderr, "Error: Could not set PEC: %s\n",
 			strerror(errno));
 		close(file);
 		exit(1);
 	}
 
+	if (until) {
+		struct timespec start, stop;
+		unsigned int polls;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (size == I2C_SMBUS_WORD_DATA)
+			res = i2c_smbus_poll_word_data(file, daddress, umask,
+						       uvalue, timeout, &polls);
+		else
+			res = i2c_smbus_poll_byte_data(file, daddress, umask,
+						       uvalue, timeout, &polls);
+		clock_gettime(CLOCK_MONOTONIC, &stop);
+		close(file);
+
+		fprintf(stderr, "%s after %u poll(s) in %.3f ms\n",
+			res == -ETIMEDOUT ? "Timed out" :
+			res >= 0 ? "Matched" : "Read failed", polls,
+			(stop.tv_sec - start.tv_sec) * 1e3
+			+ (stop.tv_nsec - start.tv_nsec) / 1e6);
+		if (res == -ETIMEDOUT)
+			exit(3);
+		if (res < 0)
+			exit(2);
+
+		printf("0x%0*x\n", size == I2C_SMBUS_WORD_DATA ? 4 : 2, res);
+		exit(0);
+	}
+
+	if (rate) {
+		sampling_setup(cpu, realtime);
+		res = sample_register(file, i2cbus, address, size, daddress,
+				      daddrlen, rate, count, binary);
+		close(file);
+		exit(res);
+	}
+
 	if (length) { /* Arbitrary number of bytes to be read */
-		if (!(resbufptr = calloc(length, sizeof(int)))) {
+		if (!(resbufptr = calloc(length, 1))) {
 			fprintf(stderr, "Error: Could not allocate buffer memory.\n");
 			close(file);
 			exit(1);
 		}
 
-		writeaddr(file, daddress, daddrlen);
-		res = read(file, resbufptr, length);
-	}
-	else {
-		switch (size) {
-		case I2C_SMBUS_BYTE:
-			writeaddr(file, daddress, daddrlen);
-			res = i2c_smbus_read_byte(file);
-			break;
-		case I2C_SMBUS_WORD_DATA:
-			res = i2c_smbus_read_word_data(file, daddress);
-			break;
-		default: /* I2C_SMBUS_BYTE_DATA */
-			res = i2c_smbus_read_byte_data(file, daddress);
-		}
+		res = read_length(file, address, daddress, daddrlen,
+				  resbufptr, length);
 	}
+	else
+		res = read_register(file, i2cbus, address, size, daddress,
+				    daddrlen);
 
 	close(file);
 
@@ -28,17 +28,24 @@
 #include <unistd.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <i2c/lock.h>
+#include <i2c/remote.h>
 #include <i2c/smbus.h>
 #include "i2cbusses.h"
 #include "util.h"
 #include "../version.h"
 
+#ifndef I2C_M_STOP
+#define I2C_M_STOP	0x8000
+#endif
+
 static void help(void) __attribute__ ((noreturn));
 
 static void help(void)
 {
 	fprintf(stderr,
-		"Usage: i2cset [-f] [-y] [-m MASK] [-r] I2CBUS CHIP-ADDRESS DATA-ADDRESS [VALUE] ... [MODE]\n"
+		"Usage: i2cset [-f] [-y] [-m MASK] [-r] [-D SOCKET] I2CBUS CHIP-ADDRESS DATA-ADDRESS [VALUE] ... [MODE]\n"
+		"       i2cset [-f] [-y] [-r] -s FILE I2CBUS\n"
 		"  I2CBUS is an integer or an I2C bus name\n"
 		"  ADDRESS is an integer (0x03 - 0x77)\n"
 		"  MODE is one of:\n"
@@ -47,20 +54,25 @@ static void help(void)
 		"    w (word data)\n"
 		"    i (I2C block data)\n"
 		"    s (SMBus block data)\n"
-		"    Append p for SMBus PEC\n");
+		"    Append p for SMBus PEC\n"
+		"  FILE contains one CHIP-ADDRESS DATA-ADDRESS VALUE [MODE [MASK]]\n"
+		"    write per line, MODE being b, w or i, or - for standard input\n"
+		"  -D goes through the i2cd daemon listening on SOCKET\n");
 	exit(1);
 }
 
-static int check_funcs(int file, int size, int pec)
+static int check_funcs(int file, int size, int pec, unsigned long *funcsp)
 {
 	unsigned long funcs;
 
 	/* check adapter functionality */
-	if (ioctl(file, I2C_FUNCS, &funcs) < 0) {
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0) {
 		fprintf(stderr, "Error: Could not get the adapter "
 			"functionality matrix: %s\n", strerror(errno));
 		return -1;
 	}
+	if (funcsp)
+		*funcsp = funcs;
 
 	switch (size) {
 	case I2C_SMBUS_BYTE:
@@ -154,17 +166,435 @@ static int confirm(const char *filename, int address, int size, int daddress,
 	return 1;
 }
 
+/*
+ * Write a byte or word register and read it back in a single I2C_RDWR
+ * transfer, so that no other transfer from this system can come in
+ * between. If the adapter can, a STOP is forced after the write so that
+ * the chip commits it, otherwise a repeated start is used. The STOP frees
+ * the bus for a moment, so on a multi-master bus, another master may
+ * access the chip before the readback.
+ * Returns the value read back, or a negative errno.
+ */
+static int write_readback_i2c(int file, int address, int size, int daddress,
+			      int value, unsigned long funcs)
+{
+	struct i2c_rdwr_ioctl_data rdwr;
+	struct i2c_msg msgs[3];
+	unsigned char wbuf[3], rbuf[2];
+	int len = size == I2C_SMBUS_WORD_DATA ? 2 : 1;
+
+	/* SMBus words are sent LSB first */
+	wbuf[0] = daddress;
+	wbuf[1] = value & 0xff;
+	wbuf[2] = value >> 8;
+
+	msgs[0].addr = address;
+	msgs[0].flags = funcs & I2C_FUNC_PROTOCOL_MANGLING ? I2C_M_STOP : 0;
+	msgs[0].len = 1 + len;
+	msgs[0].buf = wbuf;
+	msgs[1].addr = address;
+	msgs[1].flags = 0;
+	msgs[1].len = 1;
+	msgs[1].buf = wbuf;
+	msgs[2].addr = address;
+	msgs[2].flags = I2C_M_RD;
+	msgs[2].len = len;
+	msgs[2].buf = rbuf;
+
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = 3;
+	if (i2c_ioctl(file, I2C_RDWR, &rdwr) < 0)
+		return -errno;
+
+	return len == 2 ? rbuf[0] | (rbuf[1] << 8) : rbuf[0];
+}
+
+/* One write from a script, possibly merging several lines */
+struct script_op {
+	int line;
+	int address, daddress, size, pec;
+	int value, vmask;
+	int len;	/* Number of lines merged, for I2C block writes */
+	unsigned char block[I2C_SMBUS_BLOCK_MAX];
+};
+
+static int parse_script_line(char *line, struct script_op *op)
+{
+	char *tok[6], *end;
+	int ntok = 0, max;
+
+	for (tok[0] = strtok(line, " \t\r\n"); tok[ntok] && ntok < 5;
+	     tok[ntok] = strtok(NULL, " \t\r\n"))
+		ntok++;
+	if (!ntok || tok[0][0] == '#')
+		return 0;	/* Empty line or comment */
+	if (ntok < 3 || tok[ntok]) {
+		fprintf(stderr, "Error: line %d: Wrong number of fields!\n",
+			op->line);
+		return -1;
+	}
+
+	op->address = strtol(tok[0], &end, 0);
+	if (*end || op->address < 0x03 || op->address > 0x77) {
+		fprintf(stderr, "Error: line %d: Chip address invalid!\n",
+			op->line);
+		return -1;
+	}
+	op->daddress = strtol(tok[1], &end, 0);
+	if (*end || op->daddress < 0 || op->daddress > 0xff) {
+		fprintf(stderr, "Error: line %d: Data address invalid!\n",
+			op->line);
+		return -1;
+	}
+
+	op->size = I2C_SMBUS_BYTE_DATA;
+	op->pec = 0;
+	if (ntok > 3) {
+		if (strlen(tok[3]) > 2
+		 || (strlen(tok[3]) == 2 && tok[3][1] != 'p')) {
+			fprintf(stderr, "Error: line %d: Invalid mode '%s'!\n",
+				op->line, tok[3]);
+			return -1;
+		}
+		switch (tok[3][0]) {
+		case 'b': op->size = I2C_SMBUS_BYTE_DATA; break;
+		case 'w': op->size = I2C_SMBUS_WORD_DATA; break;
+		case 'i': op->size = I2C_SMBUS_I2C_BLOCK_DATA; break;
+		default:
+			fprintf(stderr, "Error: line %d: Invalid mode '%s'!\n",
+				op->line, tok[3]);
+			return -1;
+		}
+		op->pec = tok[3][1] == 'p';
+		if (op->pec && op->size == I2C_SMBUS_I2C_BLOCK_DATA) {
+			fprintf(stderr, "Error: line %d: PEC not supported for "
+				"I2C block writes!\n", op->line);
+			return -1;
+		}
+	}
+	max = op->size == I2C_SMBUS_WORD_DATA ? 0xffff : 0xff;
+
+	op->value = strtol(tok[2], &end, 0);
+	if (*end || op->value < 0 || op->value > max) {
+		fprintf(stderr, "Error: line %d: Data value invalid!\n",
+			op->line);
+		return -1;
+	}
+
+	op->vmask = 0;
+	if (ntok > 4) {
+		op->vmask = strtol(tok[4], &end, 0);
+		if (*end || op->vmask <= 0 || op->vmask > max
+		 || op->size == I2C_SMBUS_I2C_BLOCK_DATA) {
+			fprintf(stderr, "Error: line %d: Data value mask "
+				"invalid!\n", op->line);
+			return -1;
+		}
+	}
+
+	op->len = 1;
+	op->block[0] = op->value;
+
+	return 1;
+}
+
+/*
+ * Read and validate the whole script before anything is written.
+ * Contiguous I2C block writes to the same chip are merged.
+ * Returns the number of operations, or -1 on error.
+ */
+static int parse_script(const char *name, struct script_op **ops)
+{
+	FILE *f;
+	char line[256];
+	struct script_op op, *tmp, *prev;
+	int nops = 0, lineno = 0, errors = 0, res, c;
+
+	*ops = NULL;
+	if (!strcmp(name, "-"))
+		f = stdin;
+	else if (!(f = fopen(name, "r"))) {
+		fprintf(stderr, "Error: Could not open file `%s': %s\n",
+			name, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		op.line = ++lineno;
+		/* Don't parse the pieces of an overlong line as lines */
+		if (!strchr(line, '\n') && !feof(f)) {
+			fprintf(stderr, "Error: line %d: Line too long!\n",
+				op.line);
+			errors++;
+			while ((c = getc(f)) != EOF && c != '\n')
+				;
+			continue;
+		}
+		res = parse_script_line(line, &op);
+		if (res < 0)
+			errors++;
+		if (res <= 0 || errors)
+			continue;
+
+		prev = nops ? &(*ops)[nops - 1] : NULL;
+		if (prev && op.size == I2C_SMBUS_I2C_BLOCK_DATA
+		 && prev->size == I2C_SMBUS_I2C_BLOCK_DATA
+		 && prev->address == op.address
+		 && prev->daddress + prev->len == op.daddress
+		 && prev->len < I2C_SMBUS_BLOCK_MAX) {
+			prev->block[prev->len++] = op.value;
+			continue;
+		}
+
+		tmp = realloc(*ops, (nops + 1) * sizeof(op));
+		if (!tmp) {
+			fprintf(stderr, "Error: Out of memory!\n");
+			errors++;
+			break;
+		}
+		*ops = tmp;
+		(*ops)[nops++] = op;
+	}
+
+	if (f != stdin)
+		fclose(f);
+
+	if (errors) {
+		free(*ops);
+		return -1;
+	}
+	return nops;
+}
+
+static int confirm_script(const char *filename, const struct script_op *ops,
+			  int nops)
+{
+	int i, nvalues = 0, dont = 0;
+
+	fprintf(stderr, "WARNING! This program can confuse your I2C "
+		"bus, cause data loss and worse!\n");
+
+	for (i = 0; i < nops; i++) {
+		nvalues += ops[i].len;
+		if (!dont && ops[i].address >= 0x50 && ops[i].address <= 0x57) {
+			fprintf(stderr, "DANGEROUS! Writing to a serial "
+				"EEPROM on a memory DIMM\nmay render your "
+				"memory USELESS and make your system "
+				"UNBOOTABLE!\n");
+			dont++;
+		}
+	}
+
+	fprintf(stderr, "I will write %d value(s) to device file %s, "
+		"using %d transaction(s).\n", nvalues, filename, nops);
+
+	fprintf(stderr, "Continue? [%s] ", dont ? "y/N" : "Y/n");
+	fflush(stderr);
+	if (!user_ack(!dont)) {
+		fprintf(stderr, "Aborting on user request.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int read_script_op(int file, const struct script_op *op,
+			  unsigned char *block)
+{
+	switch (op->size) {
+	case I2C_SMBUS_WORD_DATA:
+		return i2c_smbus_read_word_data(file, op->daddress);
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		if (op->len > 1)
+			return i2c_smbus_read_i2c_block_data(file,
+					op->daddress, op->len, block);
+		/* Fall through */
+	default:
+		return i2c_smbus_read_byte_data(file, op->daddress);
+	}
+}
+
+static int set_script_target(int file, const struct script_op *op,
+			     int *address, int *pec, int force)
+{
+	if (op->address != *address) {
+		if (set_slave_addr(file, op->address, force))
+			return -1;
+		*address = op->address;
+	}
+
+	if (op->pec != *pec) {
+		if (i2c_ioctl(file, I2C_PEC, op->pec) < 0) {
+			fprintf(stderr, "Error: Could not %s PEC: %s\n",
+				op->pec ? "set" : "clear", strerror(errno));
+			return -1;
+		}
+		*pec = op->pec;
+	}
+
+	return 0;
+}
+
+static int run_script(const char *script, const char *i2cd_socket,
+		      int i2cbus, int force, int yes, int readback)
+{
+	struct script_op *ops;
+	char filename[20];
+	unsigned char block[I2C_SMBUS_BLOCK_MAX];
+	int nops, file, i, j, res, address = -1, pec = 0, lock;
+	int failed = 0, mismatched = 0;
+
+	nops = parse_script(script, &ops);
+	if (nops <= 0) {
+		if (!nops)
+			fprintf(stderr, "Error: No write found in script!\n");
+		return 1;
+	}
+
+	file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
+	if (file < 0) {
+		free(ops);
+		return 1;
+	}
+
+	/* Check the adapter once for every transaction type used */
+	for (i = 0; i < nops; i++) {
+		for (j = 0; j < i; j++)
+			if (ops[j].size == ops[i].size
+			 && (ops[j].pec || !ops[i].pec))
+				break;
+		if (j == i && check_funcs(file, ops[i].size, ops[i].pec, NULL))
+			goto err;
+	}
+
+	if (!yes && !confirm_script(filename, ops, nops))
+		goto done;
+
+	for (i = 0; i < nops; i++) {
+		struct script_op *op = &ops[i];
+
+		if (set_script_target(file, op, &address, &pec, force)) {
+			failed++;
+			continue;
+		}
+
+		/* Same as the command line, masked writes are done under
+		   the chip lock */
+		if (op->vmask) {
+			if (lock_chip(i2cbus, op->address, &lock)) {
+				failed++;
+				continue;
+			}
+			if (op->size == I2C_SMBUS_WORD_DATA)
+				res = i2c_smbus_update_word_data(file,
+					op->daddress, op->vmask, op->value);
+			else
+				res = i2c_smbus_update_byte_data(file,
+					op->daddress, op->vmask, op->value);
+			i2c_unlock_chip(lock);
+			if (res < 0) {
+				fprintf(stderr, "Error: line %d: Masked write "
+					"failed\n", op->line);
+				failed++;
+				continue;
+			}
+			/* What the readback should find */
+			op->value = (op->value & op->vmask)
+				  | (res & ~op->vmask);
+			continue;
+		}
+
+		switch (op->size) {
+		case I2C_SMBUS_WORD_DATA:
+			res = i2c_smbus_write_word_data(file, op->daddress,
+							op->value);
+			break;
+		case I2C_SMBUS_I2C_BLOCK_DATA:
+			if (op->len > 1) {
+				res = i2c_smbus_write_i2c_block_data(file,
+					op->daddress, op->len, op->block);
+				break;
+			}
+			/* Fall through */
+		default:
+			res = i2c_smbus_write_byte_data(file, op->daddress,
+							op->value);
+		}
+		if (res < 0) {
+			fprintf(stderr, "Error: line %d: Write failed\n",
+				op->line);
+			failed++;
+		}
+	}
+
+	printf("%d transaction(s) executed, %d failed\n", nops, failed);
+
+	if (readback) {
+		for (i = 0; i < nops; i++) {
+			struct script_op *op = &ops[i];
+
+			if (set_script_target(file, op, &address, &pec, force)
+			 || lock_chip(i2cbus, op->address, &lock))
+				res = -1;
+			else {
+				res = read_script_op(file, op, block);
+				i2c_unlock_chip(lock);
+			}
+
+			if (res < 0 || (op->len > 1 && res != op->len)) {
+				printf("Warning - line %d: readback failed\n",
+				       op->line);
+				mismatched++;
+			} else if (op->len > 1) {
+				for (j = 0; j < op->len; j++) {
+					if (block[j] == op->block[j])
+						continue;
+					printf("Warning - line %d: data "
+					       "mismatch at 0x%02x - wrote "
+					       "0x%02x, read back 0x%02x\n",
+					       op->line, op->daddress + j,
+					       op->block[j], block[j]);
+					mismatched++;
+				}
+			} else if (res != op->value) {
+				printf("Warning - line %d: data mismatch - "
+				       "wrote 0x%0*x, read back 0x%0*x\n",
+				       op->line,
+				       op->size == I2C_SMBUS_WORD_DATA ? 4 : 2,
+				       op->value,
+				       op->size == I2C_SMBUS_WORD_DATA ? 4 : 2,
+				       res);
+				mismatched++;
+			}
+		}
+		if (!mismatched)
+			printf("All values written, readback matched\n");
+	}
+
+ done:
+	close(file);
+	free(ops);
+	return failed || mismatched;
+
+ err:
+	close(file);
+	free(ops);
+	return 1;
+}
+
 int main(int argc, char *argv[])
 {
 	char *end;
-	const char *maskp = NULL;
+	const char *maskp = NULL, *script = NULL, *i2cd_socket = NULL;
 	int res, i2cbus, address, size, file;
 	int value, daddress, vmask = 0;
 	char filename[20];
 	int pec = 0;
 	int flags = 0;
-	int force = 0, yes = 0, version = 0, readback = 0;
+	int force = 0, yes = 0, version = 0, readback = 0, combined;
+	int lock = -1;
 	unsigned char block[I2C_SMBUS_BLOCK_MAX];
+	unsigned long funcs;
 	int len;
 
 	/* handle (optional) flags first */
@@ -179,6 +609,16 @@ int main(int argc, char *argv[])
 			flags++;
 			break;
 		case 'r': readback = 1; break;
+		case 's':
+			if (2+flags < argc)
+				script = argv[2+flags];
+			flags++;
+			break;
+		case 'D':
+			if (2+flags < argc)
+				i2cd_socket = argv[2+flags];
+			flags++;
+			break;
 		default:
 			fprintf(stderr, "Error: Unsupported option "
 				"\"%s\"!\n", argv[1+flags]);
@@ -193,6 +633,26 @@ int main(int argc, char *argv[])
 		exit(0);
 	}
 
+	if (script) {
+		if (argc != flags + 2 || maskp) {
+			fprintf(stderr, "Error: Script mode takes the I2C bus "
+				"as its only argument!\n");
+			help();
+		}
+		if (!strcmp(script, "-") && !yes) {
+			fprintf(stderr, "Error: Script on standard input "
+				"requires -y!\n");
+			help();
+		}
+
+		i2cbus = lookup_i2c_bus(argv[flags+1]);
+		if (i2cbus < 0)
+			help();
+
+		exit(run_script(script, i2cd_socket, i2cbus, force, yes,
+				readback));
+	}
+
 	if (argc < flags + 4)
 		help();
 
@@ -310,9 +770,9 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	file = open_i2c_dev(i2cbus, filename, sizeof(filename), 0);
+	file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
 	if (file < 0
-	 || check_funcs(file, size, pec)
+	 || check_funcs(file, size, pec, &funcs)
 	 || set_slave_addr(file, address, force))
 		exit(1);
 
@@ -320,6 +780,25 @@ int main(int argc, char *argv[])
 			     value, vmask, block, len, pec))
 		exit(0);
 
+	/*
+	 * Keep cooperating processes off the chip until the whole sequence
+	 * is done. The lock is taken after confirmation, so it is never held
+	 * while waiting for the user. It is released on exit.
+	 */
+	if ((vmask || readback) && lock_chip(i2cbus, address, &lock))
+		exit(1);
+
+	/*
+	 * On I2C adapters, the write and the readback can be done in a
+	 * single transfer. EEPROMs only start their write cycle on a STOP,
+	 * so don't chain on them unless the adapter can force one.
+	 */
+	combined = readback && !pec
+		&& (size == I2C_SMBUS_BYTE_DATA || size == I2C_SMBUS_WORD_DATA)
+		&& (funcs & I2C_FUNC_I2C)
+		&& ((funcs & I2C_FUNC_PROTOCOL_MANGLING)
+		    || address < 0x50 || address > 0x57);
+
 	if (vmask) {
 		int oldvalue;
 
@@ -359,13 +838,24 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (pec && ioctl(file, I2C_PEC, 1) < 0) {
+	if (pec && i2c_ioctl(file, I2C_PEC, 1) < 0) {
 		fprintf(stderr, "Error: Could not set PEC: %s\n",
 			strerror(errno));
 		close(file);
 		exit(1);
 	}
 
+	if (combined) {
+		res = write_readback_i2c(file, address, size, daddress, value,
+					 funcs);
+		if (res < 0) {
+			fprintf(stderr, "Error: Write failed\n");
+			close(file);
+			exit(1);
+		}
+		goto compare;
+	}
+
 	switch (size) {
 	case I2C_SMBUS_BYTE:
 		res = i2c_smbus_write_byte(file, daddress);
@@ -390,7 +880,7 @@ int main(int argc, char *argv[])
 	}
 
 	if (pec) {
-		if (ioctl(file, I2C_PEC, 0) < 0) {
+		if (i2c_ioctl(file, I2C_PEC, 0) < 0) {
 			fprintf(stderr, "Error: Could not clear PEC: %s\n",
 				strerror(errno));
 			close(file);
@@ -400,6 +890,7 @@ int main(int argc, char *argv[])
 
 	if (!readback) { /* We're done */
 		close(file);
+		i2c_unlock_chip(lock);
 		exit(0);
 	}
 
@@ -414,7 +905,10 @@ int main(int argc, char *argv[])
 	default: /* I2C_SMBUS_BYTE_DATA */
 		res = i2c_smbus_read_byte_data(file, daddress);
 	}
+
+ compare:
 	close(file);
+	i2c_unlock_chip(lock);
 
 	if (res < 0) {
 		printf("Warning - readback failed\n");
@@ -18,13 +18,16 @@
 */
 
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <i2c/remote.h>
 #include "i2cbusses.h"
 #include "util.h"
 #include "../version.h"
@@ -38,11 +41,46 @@ enum parse_state {
 #define PRINT_READ_BUF	(1 << 1)
 #define PRINT_WRITE_BUF	(1 << 2)
 #define PRINT_HEADER	(1 << 3)
+#define PRINT_HEX	(1 << 4)	/* Packed hexadecimal bytes */
+#define PRINT_JSON	(1 << 5)	/* One JSON object per transfer */
+#define PRINT_BIN	(1 << 6)	/* Raw read buffers */
+
+/*
+ * A set of messages to be sent as one transfer. If there are more than
+ * I2C_RDRW_IOCTL_MAX_MSGS, they are split into several I2C_RDWR calls.
+ */
+struct transfer {
+	struct i2c_msg *msgs;
+	unsigned nmsgs, msgs_size;
+	__u8 *buf;		/* Arena holding all message buffers */
+	size_t buf_used, buf_size;
+};
+
+struct parser {
+	enum parse_state state;
+	unsigned buf_idx;
+	int address;		/* Last address used, reused if omitted */
+	int checked;		/* Last address checked for being busy */
+	int force;
+	int file;
+};
+
+#define MAX_SWEEP_VARS	4
+
+/* A loop variable, substituted for {name} in the arguments */
+struct sweep_var {
+	char name[16];
+	unsigned long start, end, step;
+	unsigned long value;
+};
 
 static void help(void)
 {
 	fprintf(stderr,
-		"Usage: i2ctransfer [-f] [-y] [-v] [-V] I2CBUS DESC [DATA] [DESC [DATA]]...\n"
+		"Usage: i2ctransfer [-f] [-y] [-v] [-V] [-o FORMAT] [-D SOCKET] I2CBUS DESC [DATA] [DESC [DATA]]...\n"
+		"       i2ctransfer [-f] [-y] [-v] [-S] -s FILE I2CBUS\n"
+		"       i2ctransfer [-f] [-y] [-v] [-q] [-c] {-n COUNT|-t SECONDS} I2CBUS DESC [DATA]...\n"
+		"       i2ctransfer [-f] [-y] [-v] -L NAME=START:END[:STEP]... I2CBUS DESC [DATA]...\n"
 		"  I2CBUS is an integer or an I2C bus name\n"
 		"  DESC describes the transfer in the form: {r|w}LENGTH[@address]\n"
 		"    1) read/write-flag 2) LENGTH (range 0-65535) 3) I2C address (use last one if omitted)\n"
@@ -50,11 +88,23 @@ static void help(void)
 		"    = (keep value constant until LENGTH)\n"
 		"    + (increase value by 1 until LENGTH)\n"
 		"    - (decrease value by 1 until LENGTH)\n"
-		"    p (use pseudo random generator until LENGTH with value as seed)\n\n"
+		"    p (use pseudo random generator until LENGTH with value as seed)\n"
+		"  FILE (or - for stdin) holds one transfer (DESC [DATA]...) per line\n"
+		"  -n COUNT and/or -t SECONDS repeat the transfer and print statistics\n"
+		"    -q (don't print read data), -c (check read data is the same every time)\n"
+		"  -L repeats the transfer for each value of NAME from START to END,\n"
+		"    substituting it for {NAME} (or its Nth byte for {NAME.N}) in DESC and DATA\n"
+		"  FORMAT is one of text (default), hex (packed), json or bin (raw read data)\n"
+		"  -S refuses to split a transfer longer than %d messages where a\n"
+		"    repeated start would be replaced by a stop\n"
+		"  -D goes through the i2cd daemon listening on SOCKET\n\n"
 		"Example (bus 0, read 8 byte at offset 0x64 from EEPROM at 0x50):\n"
 		"  # i2ctransfer 0 w1@0x50 0x64 r8\n"
 		"Example (same EEPROM, at offset 0x42 write 0xff 0xfe ... 0xf0):\n"
-		"  # i2ctransfer 0 w17@0x50 0x42 0xff-\n");
+		"  # i2ctransfer 0 w17@0x50 0x42 0xff-\n"
+		"Example (read 16 bytes at every 16-byte offset of a 16-bit addressed EEPROM):\n"
+		"  # i2ctransfer -L off=0:0xfff0:16 0 w2@0x50 {off.1} {off.0} r16\n",
+		I2C_RDRW_IOCTL_MAX_MSGS);
 }
 
 static int check_funcs(int file)
@@ -62,7 +112,7 @@ static int check_funcs(int file)
 	unsigned long funcs;
 
 	/* check adapter functionality */
-	if (ioctl(file, I2C_FUNCS, &funcs) < 0) {
+	if (i2c_ioctl(file, I2C_FUNCS, &funcs) < 0) {
 		fprintf(stderr, "Error: Could not get the adapter "
 			"functionality matrix: %s\n", strerror(errno));
 		return -1;
@@ -76,17 +126,125 @@ static int check_funcs(int file)
 	return 0;
 }
 
-static void print_msgs(struct i2c_msg *msgs, __u32 nmsgs, unsigned flags)
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Format buffers by hand, printf for every byte is too slow */
+static void print_bytes(FILE *output, const __u8 *buf, unsigned len,
+			unsigned flags)
+{
+	char line[1024];
+	unsigned i, n = 0;
+
+	for (i = 0; i < len; i++) {
+		if (n > sizeof(line) - 8) {
+			fwrite(line, 1, n, output);
+			n = 0;
+		}
+
+		if (flags & PRINT_JSON) {
+			if (i) {
+				line[n++] = ',';
+				line[n++] = ' ';
+			}
+			if (buf[i] >= 100)
+				line[n++] = '0' + buf[i] / 100;
+			if (buf[i] >= 10)
+				line[n++] = '0' + buf[i] / 10 % 10;
+			line[n++] = '0' + buf[i] % 10;
+			continue;
+		}
+
+		if (!(flags & PRINT_HEX)) {
+			if (i)
+				line[n++] = ' ';
+			line[n++] = '0';
+			line[n++] = 'x';
+		}
+		line[n++] = hex_digits[buf[i] >> 4];
+		line[n++] = hex_digits[buf[i] & 0x0f];
+	}
+
+	fwrite(line, 1, n, output);
+}
+
+/* Write the read buffers to stdout as they are, with as few calls as possible */
+static void write_bin(struct i2c_msg *msgs, __u32 nmsgs)
+{
+	struct iovec iov[64];
+	unsigned i = 0, n, start;
+	ssize_t ret;
+
+	fflush(stdout);
+	while (i < nmsgs) {
+		for (n = 0; i < nmsgs && n < 64; i++) {
+			if (!(msgs[i].flags & I2C_M_RD) || !msgs[i].len)
+				continue;
+			iov[n].iov_base = msgs[i].buf;
+			iov[n].iov_len = msgs[i].len;
+			n++;
+		}
+
+		for (start = 0; start < n; ) {
+			ret = writev(STDOUT_FILENO, iov + start, n - start);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				fprintf(stderr, "Error: Writing read data failed: %s\n",
+					strerror(errno));
+				return;
+			}
+
+			/* Skip what was written, partial writes are possible */
+			while (start < n && (size_t)ret >= iov[start].iov_len)
+				ret -= iov[start++].iov_len;
+			if (start < n) {
+				iov[start].iov_base = (__u8 *)iov[start].iov_base + ret;
+				iov[start].iov_len -= ret;
+			}
+		}
+	}
+}
+
+/*
+ * Print the messages of a transfer. If label is set, it is printed at the
+ * beginning of every line, or as the first members of the JSON object.
+ */
+static void print_msgs(struct i2c_msg *msgs, __u32 nmsgs, unsigned flags,
+		       const char *label)
 {
 	FILE *output = flags & PRINT_STDERR ? stderr : stdout;
 	unsigned i;
-	__u16 j;
+
+	if (flags & PRINT_BIN) {
+		write_bin(msgs, nmsgs);
+		return;
+	}
+
+	if (!label)
+		label = "";
+	if (flags & PRINT_JSON)
+		fprintf(output, "{ %s\"msgs\": [", label);
 
 	for (i = 0; i < nmsgs; i++) {
 		int read = msgs[i].flags & I2C_M_RD;
 		int print_buf = (read && (flags & PRINT_READ_BUF)) ||
 				(!read && (flags & PRINT_WRITE_BUF));
 
+		if (flags & PRINT_JSON) {
+			fprintf(output, "%s { \"addr\": %u, \"read\": %s, \"len\": %u",
+				i ? "," : "", msgs[i].addr,
+				read ? "true" : "false", msgs[i].len);
+			if (print_buf) {
+				fprintf(output, ", \"data\": [");
+				print_bytes(output, msgs[i].buf, msgs[i].len, flags);
+				fprintf(output, "]");
+			}
+			fprintf(output, " }");
+			continue;
+		}
+
+		if ((flags & PRINT_HEADER) || (msgs[i].len && print_buf))
+			fputs(label, output);
 		if (flags & PRINT_HEADER)
 			fprintf(output, "msg %u: addr 0x%02x, %s, len %u",
 				i, msgs[i].addr, read ? "read" : "write", msgs[i].len);
@@ -94,21 +252,94 @@ static void print_msgs(struct i2c_msg *msgs, __u32 nmsgs, unsigned flags)
 		if (msgs[i].len && print_buf) {
 			if (flags & PRINT_HEADER)
 				fprintf(output, ", buf ");
-			for (j = 0; j < msgs[i].len - 1; j++)
-				fprintf(output, "0x%02x ", msgs[i].buf[j]);
-			/* Print final byte with newline */
-			fprintf(output, "0x%02x\n", msgs[i].buf[j]);
+			print_bytes(output, msgs[i].buf, msgs[i].len, flags);
+			fprintf(output, "\n");
 		} else if (flags & PRINT_HEADER) {
 			fprintf(output, "\n");
 		}
 	}
+
+	if (flags & PRINT_JSON)
+		fprintf(output, " ] }\n");
+}
+
+/*
+ * Find where the I2C_RDWR call sending messages from start on must end.
+ * A transfer can only be split before a write message or a message to
+ * another address, as the stop condition between two calls could
+ * otherwise reset the device state the next message depends on. If
+ * there is no such place, *unsafe is set and the call is made as long
+ * as possible.
+ */
+static unsigned chunk_end(const struct transfer *t, unsigned start,
+			  int *unsafe)
+{
+	unsigned end;
+
+	*unsafe = 0;
+	if (t->nmsgs - start <= I2C_RDRW_IOCTL_MAX_MSGS)
+		return t->nmsgs;
+
+	for (end = start + I2C_RDRW_IOCTL_MAX_MSGS; end > start; end--) {
+		if (!(t->msgs[end].flags & I2C_M_RD) ||
+		    t->msgs[end].addr != t->msgs[end - 1].addr)
+			return end;
+	}
+
+	*unsafe = 1;
+	return start + I2C_RDRW_IOCTL_MAX_MSGS;
+}
+
+/*
+ * Check where a transfer will be split. Returns the number of I2C_RDWR
+ * calls needed, or -1 if a split is unsafe and strict is set.
+ */
+static int check_chunks(const struct transfer *t, int strict)
+{
+	unsigned start, end;
+	int unsafe, calls = 0;
+
+	for (start = 0; start < t->nmsgs; start = end, calls++) {
+		end = chunk_end(t, start, &unsafe);
+		if (!unsafe)
+			continue;
+
+		if (strict) {
+			fprintf(stderr, "Error: Can't split the transfer safely after message %u\n",
+				end - 1);
+			return -1;
+		}
+		fprintf(stderr, "Warning: Transfer split after message %u breaks a repeated start chain\n",
+			end - 1);
+	}
+
+	return calls;
 }
 
-static int confirm(const char *filename, struct i2c_msg *msgs, __u32 nmsgs)
+static int confirm(const char *filename, const struct transfer *t, int calls)
 {
 	fprintf(stderr, "WARNING! This program can confuse your I2C bus, cause data loss and worse!\n");
 	fprintf(stderr, "I will send the following messages to device file %s:\n", filename);
-	print_msgs(msgs, nmsgs, PRINT_STDERR | PRINT_HEADER | PRINT_WRITE_BUF);
+	print_msgs(t->msgs, t->nmsgs, PRINT_STDERR | PRINT_HEADER | PRINT_WRITE_BUF,
+		   NULL);
+	if (calls > 1)
+		fprintf(stderr, "They will be split into %d transfers.\n", calls);
+
+	fprintf(stderr, "Continue? [y/N] ");
+	fflush(stderr);
+	if (!user_ack(0)) {
+		fprintf(stderr, "Aborting on user request.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int confirm_script(const char *filename, const char *script)
+{
+	fprintf(stderr, "WARNING! This program can confuse your I2C bus, cause data loss and worse!\n");
+	fprintf(stderr, "I will send all the messages from %s to device file %s.\n",
+		script, filename);
 
 	fprintf(stderr, "Continue? [y/N] ");
 	fflush(stderr);
@@ -120,17 +351,741 @@ static int confirm(const char *filename, struct i2c_msg *msgs, __u32 nmsgs)
 	return 1;
 }
 
+/*
+ * Allocate a message buffer from the transfer arena. The arena is only
+ * reset between transfers, so once it has grown large enough, no more
+ * allocations are needed.
+ */
+static __u8 *transfer_alloc(struct transfer *t, size_t len)
+{
+	__u8 *buf;
+	unsigned i;
+
+	if (t->buf_used + len > t->buf_size) {
+		size_t size = t->buf_size ? 2 * t->buf_size : 256;
+
+		while (size < t->buf_used + len)
+			size *= 2;
+		buf = malloc(size);
+		if (!buf)
+			return NULL;
+
+		/* Move the buffers of the messages already parsed */
+		if (t->buf_used)
+			memcpy(buf, t->buf, t->buf_used);
+		for (i = 0; i < t->nmsgs; i++)
+			if (t->msgs[i].len)
+				t->msgs[i].buf = buf + (t->msgs[i].buf - t->buf);
+		free(t->buf);
+		t->buf = buf;
+		t->buf_size = size;
+	}
+
+	buf = t->buf + t->buf_used;
+	t->buf_used += len;
+	memset(buf, 0, len);
+	return buf;
+}
+
+static void transfer_reset(struct transfer *t)
+{
+	t->nmsgs = 0;
+	t->buf_used = 0;
+}
+
+static void transfer_free(struct transfer *t)
+{
+	free(t->msgs);
+	free(t->buf);
+}
+
+/*
+ * Feed one DESC or DATA argument to the parser. Complete messages are
+ * added to the transfer. Returns 0 on success, -1 on error.
+ */
+static int parse_arg(struct parser *p, struct transfer *t, const char *arg)
+{
+	const char *arg_ptr = arg;
+	unsigned long len, raw_data;
+	__u16 flags;
+	__u8 data;
+	char *end;
+
+	switch (p->state) {
+	case PARSE_GET_DESC:
+		flags = 0;
+
+		if (t->nmsgs == t->msgs_size) {
+			unsigned size = t->msgs_size ? 2 * t->msgs_size
+						     : I2C_RDRW_IOCTL_MAX_MSGS;
+			struct i2c_msg *msgs;
+
+			msgs = realloc(t->msgs, size * sizeof(*msgs));
+			if (!msgs) {
+				fprintf(stderr, "Error: No memory for messages\n");
+				return -1;
+			}
+			t->msgs = msgs;
+			t->msgs_size = size;
+		}
+
+		switch (*arg_ptr++) {
+		case 'r': flags |= I2C_M_RD; break;
+		case 'w': break;
+		default:
+			fprintf(stderr, "Error: Invalid direction\n");
+			return -1;
+		}
+
+		len = strtoul(arg_ptr, &end, 0);
+		if (len > 0xffff || arg_ptr == end) {
+			fprintf(stderr, "Error: Length invalid\n");
+			return -1;
+		}
+
+		arg_ptr = end;
+		if (*arg_ptr) {
+			if (*arg_ptr++ != '@') {
+				fprintf(stderr, "Error: Unknown separator after length\n");
+				return -1;
+			}
+
+			/* We skip 10-bit support for now. If we want it,
+			 * it should be marked with a 't' flag before
+			 * the address here.
+			 */
+
+			if (!p->force) {
+				p->address = parse_i2c_address(arg_ptr);
+				if (p->address < 0)
+					return -1;
+
+				/* Ensure address is not busy, once */
+				if (p->address != p->checked) {
+					if (set_slave_addr(p->file, p->address, 0))
+						return -1;
+					p->checked = p->address;
+				}
+			} else {
+				/* 'force' allows whole address range */
+				p->address = strtol(arg_ptr, &end, 0);
+				if (arg_ptr == end || *end || p->address > 0x7f) {
+					fprintf(stderr, "Error: Invalid chip address\n");
+					return -1;
+				}
+			}
+		} else {
+			/* Reuse last address if possible */
+			if (p->address < 0) {
+				fprintf(stderr, "Error: No address given\n");
+				return -1;
+			}
+		}
+
+		t->msgs[t->nmsgs].addr = p->address;
+		t->msgs[t->nmsgs].flags = flags;
+		t->msgs[t->nmsgs].len = len;
+		t->msgs[t->nmsgs].buf = NULL;
+
+		if (len) {
+			t->msgs[t->nmsgs].buf = transfer_alloc(t, len);
+			if (!t->msgs[t->nmsgs].buf) {
+				fprintf(stderr, "Error: No memory for buffer\n");
+				return -1;
+			}
+		}
+
+		if (flags & I2C_M_RD || len == 0) {
+			t->nmsgs++;
+		} else {
+			p->buf_idx = 0;
+			p->state = PARSE_GET_DATA;
+		}
+
+		break;
+
+	case PARSE_GET_DATA:
+		raw_data = strtoul(arg_ptr, &end, 0);
+		if (raw_data > 0xff || arg_ptr == end) {
+			fprintf(stderr, "Error: Invalid data byte\n");
+			return -1;
+		}
+		data = raw_data;
+		len = t->msgs[t->nmsgs].len;
+
+		while (p->buf_idx < len) {
+			t->msgs[t->nmsgs].buf[p->buf_idx++] = data;
+
+			if (!*end)
+				break;
+
+			switch (*end) {
+			/* Pseudo randomness (8 bit AXR with a=13 and b=27) */
+			case 'p':
+				data = (data ^ 27) + 13;
+				data = (data << 1) | (data >> 7);
+				break;
+			case '+': data++; break;
+			case '-': data--; break;
+			case '=': break;
+			default:
+				fprintf(stderr, "Error: Invalid data byte suffix\n");
+				return -1;
+			}
+		}
+
+		if (p->buf_idx == len) {
+			t->nmsgs++;
+			p->state = PARSE_GET_DESC;
+		}
+
+		break;
+
+	default:
+		/* Should never happen */
+		fprintf(stderr, "Internal Error: Unknown state in state machine!\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Latencies are counted in a log-linear histogram, with 16 buckets per
+ * power of 2, so that soak runs take constant memory. Percentiles are
+ * within 1/16 of the true value.
+ */
+#define LAT_SUB_BITS	4
+#define LAT_BUCKETS	(64 << LAT_SUB_BITS)
+
+struct lat_stats {
+	unsigned long count;
+	unsigned long long min, max, sum;
+	unsigned long buckets[LAT_BUCKETS];
+};
+
+static unsigned lat_bucket(unsigned long long ns)
+{
+	unsigned e;
+
+	if (ns < (1 << LAT_SUB_BITS))
+		return ns;
+	for (e = LAT_SUB_BITS; e < 63 && ns >> (e + 1); e++)
+		;
+	return (e - LAT_SUB_BITS + 1) << LAT_SUB_BITS
+	       | ((ns >> (e - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1));
+}
+
+/* Lowest latency counted in bucket b */
+static unsigned long long lat_bucket_min(unsigned b)
+{
+	unsigned e = b >> LAT_SUB_BITS;
+
+	if (!e)
+		return b;
+	return (unsigned long long)((1 << LAT_SUB_BITS)
+				    | (b & ((1 << LAT_SUB_BITS) - 1))) << (e - 1);
+}
+
+static void lat_add(struct lat_stats *lat, unsigned long long ns)
+{
+	if (!lat->count++ || ns < lat->min)
+		lat->min = ns;
+	if (ns > lat->max)
+		lat->max = ns;
+	lat->sum += ns;
+	lat->buckets[lat_bucket(ns)]++;
+}
+
+/* Upper bound of the rank-th lowest latency */
+static unsigned long long lat_rank(const struct lat_stats *lat,
+				   unsigned long rank)
+{
+	unsigned long seen = 0;
+	unsigned b;
+
+	for (b = 0; b < LAT_BUCKETS - 1; b++) {
+		seen += lat->buckets[b];
+		if (seen >= rank)
+			break;
+	}
+	if (b == LAT_BUCKETS - 1 || lat_bucket_min(b + 1) - 1 > lat->max)
+		return lat->max;
+	return lat_bucket_min(b + 1) - 1;
+}
+
+static unsigned long long timespec_diff_ns(const struct timespec *a,
+					   const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000ULL
+	       + a->tv_nsec - b->tv_nsec;
+}
+
+/*
+ * Send a transfer, split at the places chosen by chunk_end() if needed.
+ * If lat isn't NULL, the latency of each I2C_RDWR call is added to it.
+ * Returns the number of messages sent, or -1 on error.
+ */
+static int send_transfer(int file, struct transfer *t, struct lat_stats *lat)
+{
+	struct i2c_rdwr_ioctl_data rdwr;
+	struct timespec before, after;
+	unsigned start, end;
+	int ret, unsafe, nmsgs_sent = 0;
+
+	for (start = 0; start < t->nmsgs; start = end) {
+		end = chunk_end(t, start, &unsafe);
+		rdwr.msgs = t->msgs + start;
+		rdwr.nmsgs = end - start;
+		if (lat)
+			clock_gettime(CLOCK_MONOTONIC, &before);
+		ret = i2c_ioctl(file, I2C_RDWR, &rdwr);
+		if (lat) {
+			clock_gettime(CLOCK_MONOTONIC, &after);
+			lat_add(lat, timespec_diff_ns(&after, &before));
+		}
+		if (ret < 0) {
+			fprintf(stderr, "Error: Sending messages failed: %s\n", strerror(errno));
+			return -1;
+		}
+		nmsgs_sent += ret;
+		if (ret < (int)(end - start))
+			break;
+	}
+
+	if (nmsgs_sent < (int)t->nmsgs)
+		fprintf(stderr, "Warning: only %d/%u messages were sent\n", nmsgs_sent, t->nmsgs);
+
+	return nmsgs_sent;
+}
+
+/*
+ * Compare the read buffers of a transfer with the ones of the first
+ * iteration, which were saved in ref. Returns the number of bytes which
+ * differ.
+ */
+static unsigned long compare_reads(const struct transfer *t, const __u8 *ref)
+{
+	unsigned long diff = 0;
+	unsigned i, j;
+
+	for (i = 0; i < t->nmsgs; i++) {
+		const __u8 *buf = t->msgs[i].buf;
+
+		if (!(t->msgs[i].flags & I2C_M_RD))
+			continue;
+		for (j = 0; j < t->msgs[i].len; j++)
+			if (buf[j] != ref[buf - t->buf + j])
+				diff++;
+	}
+
+	return diff;
+}
+
+static void print_stats(const struct transfer *t, const struct lat_stats *lat,
+			unsigned long iters, unsigned long long elapsed,
+			int compare, unsigned long mismatches,
+			unsigned long mismatch_bytes)
+{
+	unsigned long bytes = 0, i;
+	double secs = elapsed / 1e9;
+
+	for (i = 0; i < t->nmsgs; i++)
+		bytes += t->msgs[i].len;
+
+	fprintf(stderr, "%lu transfers in %.3f s: %.1f transfers/s, %.1f bytes/s\n",
+		iters, secs, iters / secs, (double)bytes * iters / secs);
+	fprintf(stderr, "Latency of %lu I2C_RDWR calls (us): min %.1f, avg %.1f, p99 %.1f, max %.1f\n",
+		lat->count, lat->min / 1e3, (double)lat->sum / lat->count / 1e3,
+		lat_rank(lat, (lat->count * 99 + 99) / 100) / 1e3, lat->max / 1e3);
+	if (compare)
+		fprintf(stderr, "%lu mismatching transfers, %lu mismatching bytes\n",
+			mismatches, mismatch_bytes);
+}
+
+/*
+ * Send the same transfer count times, or for the given number of seconds,
+ * or until the first limit is reached, then print statistics. If compare
+ * is set, read data is checked against the first iteration. Returns 0 on
+ * success, 1 if read data mismatched, -1 on error.
+ */
+static int run_repeat(int file, struct transfer *t, unsigned long count,
+		      unsigned long seconds, int compare, unsigned print_flags)
+{
+	struct timespec start, after;
+	struct lat_stats *lat;
+	unsigned long iters, diff;
+	unsigned long mismatches = 0, mismatch_bytes = 0;
+	__u8 *ref = NULL;
+	int nmsgs_sent, ret = 0;
+
+	lat = calloc(1, sizeof(*lat));
+	if (!lat) {
+		fprintf(stderr, "Error: No memory for statistics\n");
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	after = start;
+	for (iters = 0; !count || iters < count; iters++) {
+		if (seconds &&
+		    timespec_diff_ns(&after, &start) >= seconds * 1000000000ULL)
+			break;
+
+		nmsgs_sent = send_transfer(file, t, lat);
+		clock_gettime(CLOCK_MONOTONIC, &after);
+		if (nmsgs_sent != (int)t->nmsgs) {
+			fprintf(stderr, "Error: Transfer %lu failed\n", iters + 1);
+			ret = -1;
+			break;
+		}
+
+		if (compare) {
+			if (!ref) {
+				ref = malloc(t->buf_used);
+				if (!ref) {
+					fprintf(stderr, "Error: No memory for read data\n");
+					ret = -1;
+					break;
+				}
+				memcpy(ref, t->buf, t->buf_used);
+			} else if ((diff = compare_reads(t, ref))) {
+				mismatches++;
+				mismatch_bytes += diff;
+				if (print_flags)
+					fprintf(stderr, "Warning: Read data of transfer %lu differs\n",
+						iters + 1);
+			}
+		}
+
+		if (print_flags)
+			print_msgs(t->msgs, nmsgs_sent, print_flags, NULL);
+	}
+
+	fflush(stdout);
+	if (iters)
+		print_stats(t, lat, iters, timespec_diff_ns(&after, &start),
+			    compare, mismatches, mismatch_bytes);
+	if (!ret && mismatches)
+		ret = 1;
+
+	free(ref);
+	free(lat);
+	return ret;
+}
+
+/* Parse NAME=START:END[:STEP]. Returns 0 on success, -1 on error. */
+static int parse_sweep_var(const char *arg, struct sweep_var *var)
+{
+	const char *p = arg;
+	char *end;
+	size_t len;
+
+	len = strspn(p, "abcdefghijklmnopqrstuvwxyz"
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+	if (!len || len >= sizeof(var->name) || p[len] != '=')
+		goto err;
+	memcpy(var->name, p, len);
+	var->name[len] = '\0';
+	p += len + 1;
+
+	var->start = strtoul(p, &end, 0);
+	if (end == p || *end != ':')
+		goto err;
+	p = end + 1;
+	var->end = strtoul(p, &end, 0);
+	if (end == p || var->end < var->start)
+		goto err;
+	var->step = 1;
+	if (*end == ':') {
+		p = end + 1;
+		var->step = strtoul(p, &end, 0);
+		if (end == p || !var->step)
+			goto err;
+	}
+	if (*end)
+		goto err;
+
+	return 0;
+
+ err:
+	fprintf(stderr, "Error: Invalid loop variable \"%s\"\n", arg);
+	return -1;
+}
+
+/*
+ * Copy arg to out, replacing {name} with the decimal value of a loop
+ * variable and {name.N} with its Nth byte (0 being the least significant
+ * one). Returns 0 on success, -1 on error.
+ */
+static int expand_arg(const char *arg, const struct sweep_var *vars,
+		      int nvars, char *out, size_t size)
+{
+	const char *close, *dot;
+	unsigned long value, byte;
+	size_t len, n = 0;
+	char *end;
+	int i;
+
+	while (*arg) {
+		if (*arg != '{') {
+			if (n + 1 >= size)
+				goto too_long;
+			out[n++] = *arg++;
+			continue;
+		}
+
+		arg++;
+		close = strchr(arg, '}');
+		if (!close) {
+			fprintf(stderr, "Error: Missing '}'\n");
+			return -1;
+		}
+		dot = memchr(arg, '.', close - arg);
+		len = (dot ? dot : close) - arg;
+
+		for (i = 0; i < nvars; i++)
+			if (strlen(vars[i].name) == len &&
+			    !strncmp(vars[i].name, arg, len))
+				break;
+		if (i == nvars) {
+			fprintf(stderr, "Error: Unknown loop variable \"%.*s\"\n",
+				(int)len, arg);
+			return -1;
+		}
+
+		value = vars[i].value;
+		if (dot) {
+			byte = strtoul(dot + 1, &end, 10);
+			if (end != close || end == dot + 1 ||
+			    byte >= sizeof(value)) {
+				fprintf(stderr, "Error: Invalid byte index in \"{%.*s}\"\n",
+					(int)(close - arg), arg);
+				return -1;
+			}
+			value = (value >> (8 * byte)) & 0xff;
+		}
+
+		len = snprintf(out + n, size - n, "%lu", value);
+		if (len >= size - n)
+			goto too_long;
+		n += len;
+		arg = close + 1;
+	}
+
+	out[n] = '\0';
+	return 0;
+
+ too_long:
+	fprintf(stderr, "Error: Argument too long after substitution\n");
+	return -1;
+}
+
+static void format_label(const struct sweep_var *vars, int nvars,
+			 unsigned flags, char *label, size_t size)
+{
+	size_t n = 0;
+	int i;
+
+	label[0] = '\0';
+	for (i = 0; i < nvars && n < size; i++) {
+		if (flags & PRINT_JSON)
+			n += snprintf(label + n, size - n, "\"%s\": %lu, ",
+				      vars[i].name, vars[i].value);
+		else
+			n += snprintf(label + n, size - n, "%s=0x%lx ",
+				      vars[i].name, vars[i].value);
+	}
+}
+
+static int confirm_sweep(const char *filename, char *args[], int nargs,
+			 const struct sweep_var *vars, int nvars)
+{
+	unsigned long long count = 1;
+	int i;
+
+	for (i = 0; i < nvars; i++)
+		count *= (vars[i].end - vars[i].start) / vars[i].step + 1;
+
+	fprintf(stderr, "WARNING! This program can confuse your I2C bus, cause data loss and worse!\n");
+	fprintf(stderr, "I will send %llu transfers to device file %s, built from:\n",
+		count, filename);
+	for (i = 0; i < nargs; i++)
+		fprintf(stderr, "%s%c", args[i], i == nargs - 1 ? '\n' : ' ');
+	for (i = 0; i < nvars; i++)
+		fprintf(stderr, "with %s from 0x%lx to 0x%lx by %lu\n",
+			vars[i].name, vars[i].start, vars[i].end, vars[i].step);
+
+	fprintf(stderr, "Continue? [y/N] ");
+	fflush(stderr);
+	if (!user_ack(0)) {
+		fprintf(stderr, "Aborting on user request.\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Send one transfer for every combination of the loop variable values,
+ * the last variable changing fastest. The arguments are parsed again for
+ * every transfer, but the buffers are reused. Returns 0 on success, -1
+ * on error.
+ */
+static int run_sweep(struct parser *p, struct transfer *t, char *args[],
+		     int nargs, struct sweep_var *vars, int nvars, int strict,
+		     unsigned print_flags)
+{
+	char arg[256], label[256], where[256];
+	int i, nmsgs_sent;
+
+	for (i = 0; i < nvars; i++)
+		vars[i].value = vars[i].start;
+
+	for (;;) {
+		format_label(vars, nvars, print_flags, label, sizeof(label));
+		format_label(vars, nvars, 0, where, sizeof(where));
+		where[strlen(where) - 1] = '\0';	/* Trailing space */
+		transfer_reset(t);
+
+		for (i = 0; i < nargs; i++) {
+			if (expand_arg(args[i], vars, nvars, arg, sizeof(arg)) ||
+			    parse_arg(p, t, arg)) {
+				fprintf(stderr, "Error: faulty argument is '%s' for %s\n",
+					args[i], where);
+				return -1;
+			}
+		}
+
+		if (p->state != PARSE_GET_DESC || t->nmsgs == 0) {
+			fprintf(stderr, "Error: Incomplete message\n");
+			return -1;
+		}
+		if (check_chunks(t, strict) < 0)
+			return -1;
+
+		nmsgs_sent = send_transfer(p->file, t, NULL);
+		if (nmsgs_sent < 0) {
+			fprintf(stderr, "Error: Transfer for %s failed\n", where);
+			return -1;
+		}
+		print_msgs(t->msgs, nmsgs_sent, print_flags, label);
+
+		/* Move on to the next combination */
+		for (i = nvars - 1; i >= 0; i--) {
+			if (vars[i].end - vars[i].value >= vars[i].step) {
+				vars[i].value += vars[i].step;
+				break;
+			}
+			vars[i].value = vars[i].start;
+		}
+		if (i < 0)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Execute a file of transfers, one per line. Each transfer is sent as
+ * soon as its line is parsed, and its results are printed right away.
+ * Returns 0 on success, -1 on error.
+ */
+static int run_script(const char *script, struct parser *p,
+		      struct transfer *t, int strict, unsigned print_flags)
+{
+	FILE *f;
+	char *line = NULL, *tok;
+	size_t line_size = 0;
+	int lineno = 0, nmsgs_sent, ret = 0;
+
+	if (!strcmp(script, "-"))
+		f = stdin;
+	else if (!(f = fopen(script, "r"))) {
+		fprintf(stderr, "Error: Could not open file `%s': %s\n",
+			script, strerror(errno));
+		return -1;
+	}
+
+	while (getline(&line, &line_size, f) > 0) {
+		lineno++;
+		transfer_reset(t);
+
+		for (tok = strtok(line, " \t\r\n"); tok && tok[0] != '#';
+		     tok = strtok(NULL, " \t\r\n")) {
+			if (parse_arg(p, t, tok)) {
+				fprintf(stderr, "Error: faulty argument is '%s' on line %d\n",
+					tok, lineno);
+				ret = -1;
+				goto out;
+			}
+		}
+
+		if (p->state != PARSE_GET_DESC) {
+			fprintf(stderr, "Error: Incomplete message on line %d\n",
+				lineno);
+			ret = -1;
+			goto out;
+		}
+		if (!t->nmsgs)
+			continue;	/* Empty line or comment */
+		if (check_chunks(t, strict) < 0) {
+			fprintf(stderr, "Error: Transfer on line %d not sent\n",
+				lineno);
+			ret = -1;
+			goto out;
+		}
+
+		nmsgs_sent = send_transfer(p->file, t, NULL);
+		if (nmsgs_sent < 0) {
+			fprintf(stderr, "Error: Transfer on line %d failed\n",
+				lineno);
+			ret = -1;
+			goto out;
+		}
+
+		print_msgs(t->msgs, nmsgs_sent, print_flags, NULL);
+		fflush(stdout);
+	}
+
+ out:
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return ret;
+}
+
+/* Returns the PRINT_* flag for an output format, or -1 if unknown */
+static int parse_format(const char *name)
+{
+	if (!strcmp(name, "text"))
+		return 0;
+	if (!strcmp(name, "hex"))
+		return PRINT_HEX;
+	if (!strcmp(name, "json"))
+		return PRINT_JSON;
+	if (!strcmp(name, "bin"))
+		return PRINT_BIN;
+	return -1;
+}
+
 int main(int argc, char *argv[])
 {
 	char filename[20];
-	int i2cbus, address = -1, file, arg_idx = 1, nmsgs = 0, nmsgs_sent, i;
+	const char *script = NULL, *i2cd_socket = NULL;
+	int i2cbus, file, arg_idx = 1, nmsgs_sent;
 	int force = 0, yes = 0, version = 0, verbose = 0;
-	struct i2c_msg msgs[I2C_RDRW_IOCTL_MAX_MSGS];
-	enum parse_state state = PARSE_GET_DESC;
-	unsigned buf_idx = 0;
+	int quiet = 0, compare = 0, strict = 0, calls;
+	int format = 0;
+	struct sweep_var vars[MAX_SWEEP_VARS];
+	int nvars = 0, i;
+	unsigned long count = 0, seconds = 0, val;
+	char *end;
+	unsigned print_flags;
+	struct transfer t;
+	struct parser p;
 
-	for (i = 0; i < I2C_RDRW_IOCTL_MAX_MSGS; i++)
-		msgs[i].buf = NULL;
+	memset(&t, 0, sizeof(t));
 
 	/* handle (optional) arg_idx first */
 	while (arg_idx < argc && argv[arg_idx][0] == '-') {
@@ -139,6 +1094,66 @@ int main(int argc, char *argv[])
 		case 'v': verbose = 1; break;
 		case 'f': force = 1; break;
 		case 'y': yes = 1; break;
+		case 'q': quiet = 1; break;
+		case 'S': strict = 1; break;
+		case 'c': compare = 1; break;
+		case 's':
+			if (arg_idx + 1 < argc)
+				script = argv[++arg_idx];
+			break;
+		case 'D':
+			if (arg_idx + 1 < argc)
+				i2cd_socket = argv[++arg_idx];
+			break;
+		case 'L':
+			if (arg_idx + 1 == argc) {
+				help();
+				exit(1);
+			}
+			if (nvars == MAX_SWEEP_VARS) {
+				fprintf(stderr, "Error: Too many loop variables (max: %d)!\n",
+					MAX_SWEEP_VARS);
+				exit(1);
+			}
+			if (parse_sweep_var(argv[++arg_idx], &vars[nvars]))
+				exit(1);
+			for (i = 0; i < nvars; i++) {
+				if (!strcmp(vars[i].name, vars[nvars].name)) {
+					fprintf(stderr, "Error: Loop variable %s defined twice!\n",
+						vars[i].name);
+					exit(1);
+				}
+			}
+			nvars++;
+			break;
+		case 'o':
+			if (arg_idx + 1 == argc) {
+				help();
+				exit(1);
+			}
+			format = parse_format(argv[++arg_idx]);
+			if (format < 0) {
+				fprintf(stderr, "Error: Unsupported output format \"%s\"!\n",
+					argv[arg_idx]);
+				exit(1);
+			}
+			break;
+		case 'n':
+		case 't':
+			if (arg_idx + 1 == argc) {
+				help();
+				exit(1);
+			}
+			val = strtoul(argv[arg_idx + 1], &end, 0);
+			if (*end || !val) {
+				fprintf(stderr, "Error: Invalid repeat count or time!\n");
+				exit(1);
+			}
+			if (argv[arg_idx++][1] == 'n')
+				count = val;
+			else
+				seconds = val;
+			break;
 		default:
 			fprintf(stderr, "Error: Unsupported option \"%s\"!\n",
 				argv[arg_idx]);
@@ -153,180 +1168,112 @@ int main(int argc, char *argv[])
 		exit(0);
 	}
 
-	if (arg_idx == argc) {
+	if (arg_idx == argc || (script && arg_idx + 1 != argc)) {
 		help();
 		exit(1);
 	}
 
-	i2cbus = lookup_i2c_bus(argv[arg_idx++]);
-	if (i2cbus < 0)
+	if ((format & PRINT_BIN) && verbose) {
+		fprintf(stderr, "Error: Binary output can't be verbose!\n");
 		exit(1);
+	}
 
-	file = open_i2c_dev(i2cbus, filename, sizeof(filename), 0);
-	if (file < 0 || check_funcs(file))
+	if ((quiet || compare) && !(count || seconds)) {
+		fprintf(stderr, "Error: Options -q and -c require -n or -t!\n");
 		exit(1);
+	}
 
-	while (arg_idx < argc) {
-		char *arg_ptr = argv[arg_idx];
-		unsigned long len, raw_data;
-		__u16 flags;
-		__u8 data, *buf;
-		char *end;
-
-		if (nmsgs > I2C_RDRW_IOCTL_MAX_MSGS) {
-			fprintf(stderr, "Error: Too many messages (max: %d)\n",
-				I2C_RDRW_IOCTL_MAX_MSGS);
-			goto err_out;
-		}
-
-		switch (state) {
-		case PARSE_GET_DESC:
-			flags = 0;
-
-			switch (*arg_ptr++) {
-			case 'r': flags |= I2C_M_RD; break;
-			case 'w': break;
-			default:
-				fprintf(stderr, "Error: Invalid direction\n");
-				goto err_out_with_arg;
-			}
-
-			len = strtoul(arg_ptr, &end, 0);
-			if (len > 0xffff || arg_ptr == end) {
-				fprintf(stderr, "Error: Length invalid\n");
-				goto err_out_with_arg;
-			}
-
-			arg_ptr = end;
-			if (*arg_ptr) {
-				if (*arg_ptr++ != '@') {
-					fprintf(stderr, "Error: Unknown separator after length\n");
-					goto err_out_with_arg;
-				}
-
-				/* We skip 10-bit support for now. If we want it,
-				 * it should be marked with a 't' flag before
-				 * the address here.
-				 */
-
-				if (!force) {
-					address = parse_i2c_address(arg_ptr);
-					if (address < 0)
-						goto err_out_with_arg;
-
-					/* Ensure address is not busy */
-					if (set_slave_addr(file, address, 0))
-						goto err_out_with_arg;
-				} else {
-					/* 'force' allows whole address range */
-					address = strtol(arg_ptr, &end, 0);
-					if (arg_ptr == end || *end || address > 0x7f) {
-						fprintf(stderr, "Error: Invalid chip address\n");
-						goto err_out_with_arg;
-					}
-				}
-			} else {
-				/* Reuse last address if possible */
-				if (address < 0) {
-					fprintf(stderr, "Error: No address given\n");
-					goto err_out_with_arg;
-				}
-			}
-
-			msgs[nmsgs].addr = address;
-			msgs[nmsgs].flags = flags;
-			msgs[nmsgs].len = len;
-
-			if (len) {
-				buf = malloc(len);
-				if (!buf) {
-					fprintf(stderr, "Error: No memory for buffer\n");
-					goto err_out_with_arg;
-				}
-				memset(buf, 0, len);
-				msgs[nmsgs].buf = buf;
-			}
-
-			if (flags & I2C_M_RD || len == 0) {
-				nmsgs++;
-			} else {
-				buf_idx = 0;
-				state = PARSE_GET_DATA;
-			}
-
-			break;
+	if (nvars && (script || count || seconds)) {
+		fprintf(stderr, "Error: Loop variables can't be used with -s, -n or -t!\n");
+		exit(1);
+	}
 
-		case PARSE_GET_DATA:
-			raw_data = strtoul(arg_ptr, &end, 0);
-			if (raw_data > 0xff || arg_ptr == end) {
-				fprintf(stderr, "Error: Invalid data byte\n");
-				goto err_out_with_arg;
-			}
-			data = raw_data;
-			len = msgs[nmsgs].len;
+	if (script && (count || seconds)) {
+		fprintf(stderr, "Error: Script mode can't be repeated!\n");
+		exit(1);
+	}
 
-			while (buf_idx < len) {
-				msgs[nmsgs].buf[buf_idx++] = data;
+	if (script && !strcmp(script, "-") && !yes) {
+		fprintf(stderr, "Error: Script on standard input requires -y!\n");
+		exit(1);
+	}
 
-				if (!*end)
-					break;
+	i2cbus = lookup_i2c_bus(argv[arg_idx++]);
+	if (i2cbus < 0)
+		exit(1);
 
-				switch (*end) {
-				/* Pseudo randomness (8 bit AXR with a=13 and b=27) */
-				case 'p':
-					data = (data ^ 27) + 13;
-					data = (data << 1) | (data >> 7);
-					break;
-				case '+': data++; break;
-				case '-': data--; break;
-				case '=': break;
-				default:
-					fprintf(stderr, "Error: Invalid data byte suffix\n");
-					goto err_out_with_arg;
-				}
-			}
+	file = open_i2c_dev_via(i2cd_socket, i2cbus, filename, sizeof(filename), 0);
+	if (file < 0 || check_funcs(file))
+		exit(1);
 
-			if (buf_idx == len) {
-				nmsgs++;
-				state = PARSE_GET_DESC;
-			}
+	p.state = PARSE_GET_DESC;
+	p.address = -1;
+	p.checked = -1;
+	p.force = force;
+	p.file = file;
+	print_flags = format | PRINT_READ_BUF |
+		      (verbose ? PRINT_HEADER | PRINT_WRITE_BUF : 0);
 
-			break;
+	if (script) {
+		if (!yes && !confirm_script(filename, script))
+			goto out;
+		if (run_script(script, &p, &t, strict, print_flags))
+			goto err_out;
+		goto out;
+	}
 
-		default:
-			/* Should never happen */
-			fprintf(stderr, "Internal Error: Unknown state in state machine!\n");
+	if (nvars) {
+		if (!yes && !confirm_sweep(filename, argv + arg_idx,
+					   argc - arg_idx, vars, nvars))
+			goto out;
+		if (run_sweep(&p, &t, argv + arg_idx, argc - arg_idx, vars,
+			      nvars, strict, print_flags))
 			goto err_out;
-		}
+		goto out;
+	}
 
+	while (arg_idx < argc) {
+		if (parse_arg(&p, &t, argv[arg_idx]))
+			goto err_out_with_arg;
 		arg_idx++;
 	}
 
-	if (state != PARSE_GET_DESC || nmsgs == 0) {
+	if (p.state != PARSE_GET_DESC || t.nmsgs == 0) {
 		fprintf(stderr, "Error: Incomplete message\n");
 		goto err_out;
 	}
 
-	if (yes || confirm(filename, msgs, nmsgs)) {
-		struct i2c_rdwr_ioctl_data rdwr;
+	calls = check_chunks(&t, strict);
+	if (calls < 0)
+		goto err_out;
 
-		rdwr.msgs = msgs;
-		rdwr.nmsgs = nmsgs;
-		nmsgs_sent = ioctl(file, I2C_RDWR, &rdwr);
-		if (nmsgs_sent < 0) {
-			fprintf(stderr, "Error: Sending messages failed: %s\n", strerror(errno));
+	if (count || seconds) {
+		if (!yes && !confirm(filename, &t, calls))
+			goto out;
+		switch (run_repeat(file, &t, count, seconds, compare,
+				   quiet ? 0 : print_flags)) {
+		case 0:
+			goto out;
+		case 1:
+			close(file);
+			transfer_free(&t);
+			exit(2);
+		default:
 			goto err_out;
-		} else if (nmsgs_sent < nmsgs) {
-			fprintf(stderr, "Warning: only %d/%d messages were sent\n", nmsgs_sent, nmsgs);
 		}
+	}
+
+	if (yes || confirm(filename, &t, calls)) {
+		nmsgs_sent = send_transfer(file, &t, NULL);
+		if (nmsgs_sent < 0)
+			goto err_out;
 
-		print_msgs(msgs, nmsgs_sent, PRINT_READ_BUF | (verbose ? PRINT_HEADER | PRINT_WRITE_BUF : 0));
+		print_msgs(t.msgs, nmsgs_sent, print_flags, NULL);
 	}
 
+ out:
 	close(file);
-
-	for (i = 0; i < nmsgs; i++)
-		free(msgs[i].buf);
+	transfer_free(&t);
 
 	exit(0);
 
@@ -334,9 +1281,7 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "Error: faulty argument is '%s'\n", argv[arg_idx]);
  err_out:
 	close(file);
-
-	for (i = 0; i <= nmsgs; i++)
-		free(msgs[i].buf);
+	transfer_free(&t);
 
 	exit(1);
 }